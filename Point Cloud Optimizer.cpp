@@ -1,143 +1,43 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
-#include "point.hpp"
 #include <sstream>
-#include <iomanip>
-#include "rply.h"
-#include "nanoflann.hpp"
-#include "point_cloud.hpp"
+#include <algorithm>
+#include <csignal>
+#include "optimizer.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+#include "progress.hpp"
+#include "cancellation.hpp"
+#include "leaf_kernel.hpp"
+#include "memory_placement.hpp"
 
 using namespace std;
 using namespace nanoflann;
 
-typedef vector<size_t> cluster;
-typedef KDTreeSingleIndexAdaptor <L2_Simple_Adaptor<float, point_cloud<float> >, point_cloud<float>, point::dimension> tree; // K-D tree holding indices from "points" vector
-
-point_cloud<float> cloud; // point cloud itself holding actual data to points
-vector<cluster> initial_clusters; // cluster holds indices to its members (index 0 refers to cluster centroid)
-vector<cluster> new_clusters; // used as final storage of clusters after subdivision of initial clusters
-
-// Space Interval Threshold (DT) - largest distance from cluster centroid to any cluster member
-float space_interval_dt;
-float space_interval_dt_default = 1;
-
-// Normal Vector Deviation Threshold (NT) - largest deviation of normal vectors of any pair of cluster members (otherwise cluster is divided)
-float vector_deviation_nt;
+float space_interval_dt_default = 1; // radius of initial clusters (same result as older versions, which searched within sqrt(DT))
 float vector_deviation_nt_default = 0.5;
 
 enum user_def_variables { space_interval_var, vector_deviation_var };
 
-string file_name_extention(".ply");
 string default_file_name("PointCloud" + file_name_extention);
 string modified_file_suffix("_REDUCED");
-
-int position = 0;
-float buffer[9];
-/** @brief Callback for parse. This method is called for every element found.
-*/
-static int vertex_cb(const p_ply_argument argument)
-{
-	buffer[position] = static_cast<float>(ply_get_argument_value(argument));
-	position++;
-
-	if (position == 9)
-	{
-		position = 0;
-		cloud.points.emplace_back(buffer);
-	}
-
-	return 1;
-}
-
-/** @brief Uses RPly to parse point cloud from external ASCII .ply file.
- *File is expected to comply .fly standards with this specific structure/header:
-
-ply
-format ascii 1.0
-element vertex <number of vertices>
-property float x
-property float y
-property float z
-property uchar red
-property uchar green
-property uchar blue
-property float nx
-property float ny
-property float nz
-end_header
-
-Other elements, properties and comments are ignored and are not transfered into output file.
-*/
-void import_point_cloud(const string& file_name)
-{
-	cout << endl << "Importing and parsing file: " + file_name << endl;
-
-	const p_ply ply = ply_open(file_name.c_str(), nullptr, 0, nullptr);
-
-	if (!ply) 
-		throw exception();
-
-	if (!ply_read_header(ply)) 
-		throw exception();
-
-	const long number_of_elements = ply_set_read_cb(ply, "vertex", "x", vertex_cb, nullptr, 0);
-	ply_set_read_cb(ply, "vertex", "y", vertex_cb, nullptr, 0);
-	ply_set_read_cb(ply, "vertex", "z", vertex_cb, nullptr, 0);
-	ply_set_read_cb(ply, "vertex", "red", vertex_cb, nullptr, 0);
-	ply_set_read_cb(ply, "vertex", "green", vertex_cb, nullptr, 0);
-	ply_set_read_cb(ply, "vertex", "blue", vertex_cb, nullptr, 0);
-	ply_set_read_cb(ply, "vertex", "nx", vertex_cb, nullptr, 0);
-	ply_set_read_cb(ply, "vertex", "ny", vertex_cb, nullptr, 0);
-	ply_set_read_cb(ply, "vertex", "nz", vertex_cb, nullptr, 1);
-
-	cloud.points.reserve(number_of_elements);
-
-	if (!ply_read(ply))
-		throw exception();
-	
-	ply_close(ply);
-}
-
-/** @brief Creates initial clusters. If point is not marked, it becames centroid of new cluster. 
- *	This new cluster contains non-marked neighbours of centroid whose distance is less than or equal to Space Interval Threshold (DT).
-*/
-void cluster_initialization(const tree& my_tree)
-{
-	cout << "Initializing clusters." << endl;
-
-	for (size_t i = 0; i < cloud.points.size(); ++i)
-	{
-		if (!cloud.points[i].is_marked)
-		{
-			cloud.points[i].is_centroid = true;
-
-			float* centroid = cloud.points[i].data; // index to centroid is at index 0 in cluster
-			const float radius = space_interval_dt;
-			vector<std::pair<size_t, float>> indices_dists;
-
-			my_tree.radiusSearch(centroid, radius, indices_dists, SearchParams());
-
-			// create new cluster
-			initial_clusters.resize(initial_clusters.size() + 1);
-			vector<size_t>& current_cluster = initial_clusters[initial_clusters.size() - 1];
-			current_cluster.reserve(indices_dists.size());
-
-			// fill the new cluster
-			for (size_t j = 0; j < indices_dists.size(); ++j)
-			{
-				size_t point_index = indices_dists[j].first;
-
-				if (!cloud.points[point_index].is_marked) // do not copy indices to marked points to cluster; they already are in another cluster
-				{
-					current_cluster.push_back(point_index);
-					cloud.points[point_index].is_marked = true;
-				}
-			}
-		}
-	}
-}
+string level_of_detail_suffix("_LOD"); // followed by number of level (0 is finest)
+
+// optional switches given as --name or --name=value (see process_options); switches of pipeline stages are declared in optimizer.hpp
+bool boundary_subdivision = false; // --boundary: detect boundary clusters and divide them to keep boundaries with finer detail
+string report_file_name; // --report=path: write per-stage timing and memory report as JSON
+bool show_progress = false; // --progress[=path]: print progress of stages with rate and ETA, optionally also write it to file as JSON
+string progress_file_name;
+vector<float> level_space_intervals; // --lod=DT1,DT2,...: write reduced cloud for every DT (level of detail) from one import and one K-D tree
+size_t octree_node_points = 0; // --octree[=N]: also write reduced cloud as octree tiles with at most N points per node (20000 by default)
+size_t target_points = 0; // --target-points=N: search DT which reduces cloud to about N points (DT argument is then omitted)
+double target_ratio = 0; // --target-ratio=r: same as --target-points with N = r * number of input points
+double time_budget = 0; // --time-budget=seconds: cancel run when time is up and export best available result (0 = no budget);
+                         // time for export of .ply file is kept at end of budget (octree export is not included), but budget is exceeded
+                         // when clustering still shortens export more than it takes; overrun is in run report
+
+instrumentation::run_report report; // measurements of stages of this run
 
 /** @brief Decides whether value of specific user variable is valid.
 */
@@ -296,6 +196,167 @@ float process_float_arg(const int argc, char** argv, const int index, const user
 	}
 }
 
+/** @brief Processes optional switches given as --name or --name=value anywhere in arguments. Unknown switches are ignored.
+ *	Options --lod, --target-points and --target-ratio cannot be combined; only first of them is used.
+ *	Returns remaining (positional) arguments, starting with name of this program.
+*/
+vector<char*> process_options(const int argc, char* argv[])
+{
+	vector<char*> positional_args;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		const string arg(argv[i]);
+
+		if (i == 0 || arg.compare(0, 2, "--") != 0)
+		{
+			positional_args.push_back(argv[i]);
+			continue;
+		}
+
+		const size_t equals = arg.find('=');
+		const string name = arg.substr(2, equals == string::npos ? string::npos : equals - 2);
+
+		const string value = equals == string::npos ? "" : arg.substr(equals + 1);
+
+		// each of these options chooses DT in its own way, so only first of them is used
+		const bool chooses_space_interval = name == "lod" || name == "target-points" || name == "target-ratio";
+
+		if (chooses_space_interval && (!level_space_intervals.empty() || target_points > 0 || target_ratio > 0))
+		{
+			cout << "Only one of options --lod, --target-points and --target-ratio can be given. Option " << arg << " is ignored." << endl;
+			continue;
+		}
+
+		try
+		{
+			if (name == "cache")
+				use_cache = true;
+			else if (name == "boundary")
+				boundary_subdivision = true;
+			else if (name == "morton")
+				morton_order = true;
+			else if (name == "representative")
+			{
+				if (value != "mean" && value != "seed")
+					throw invalid_argument(value);
+
+				mean_representatives = value == "mean";
+			}
+			else if (name == "leaf-order")
+				leaf_order = true;
+			else if (name == "claim-index")
+				use_claim_index = true;
+			else if (name == "implicit-tree")
+				use_implicit_tree = true;
+			else if (name == "leaf-kernel")
+			{
+				if (value != "scalar" && value != "avx2" && value != "avx512")
+					throw invalid_argument(value);
+
+				leaf_kernel::active() = leaf_kernel::select(value);
+
+				if (leaf_kernel::active().name != value)
+					cout << "Processor does not support " << value << " leaf kernel; " << leaf_kernel::active().name << " kernel is used instead." << endl;
+			}
+			else if (name == "huge-pages") // back point array and arrays of search indices by transparent huge pages
+				memory_placement::active().huge_pages = true;
+			else if (name == "numa") // --numa=interleave|first-touch: placement of these arrays on NUMA nodes
+			{
+				if (value == "interleave")
+					memory_placement::active().numa = memory_placement::numa_policy::interleave;
+				else if (value == "first-touch")
+					memory_placement::active().numa = memory_placement::numa_policy::first_touch;
+				else
+					throw invalid_argument(value);
+			}
+			else if (name == "stats")
+				statistics.enabled = true;
+			else if (name == "progress")
+			{
+				show_progress = true;
+				progress_file_name = value;
+			}
+			else if (name == "lod")
+			{
+				string item;
+				istringstream value_stream(value);
+				vector<float> levels; // assigned only if all of them are valid, so invalid option is ignored as whole
+
+				while (getline(value_stream, item, ','))
+				{
+					levels.push_back(stof(item));
+
+					if (!user_var_value_is_valid(levels.back(), space_interval_var))
+						throw invalid_argument(value);
+				}
+
+				if (levels.empty())
+					throw invalid_argument(value);
+
+				// every level is computed from previous (finer) one
+				sort(levels.begin(), levels.end());
+				levels.erase(unique(levels.begin(), levels.end()), levels.end());
+				level_space_intervals = levels;
+			}
+			else if (name == "octree")
+			{
+				octree_node_points = value.empty() ? 20000 : stoul(value);
+
+				if (octree_node_points == 0)
+					throw invalid_argument(value);
+			}
+			else if (name == "target-points")
+			{
+				target_points = static_cast<size_t>(stod(value));
+
+				if (target_points == 0)
+					throw invalid_argument(value);
+			}
+			else if (name == "target-ratio")
+			{
+				const double ratio = stod(value);
+
+				if (ratio <= 0 || ratio > 1)
+					throw invalid_argument(value);
+
+				target_ratio = ratio;
+			}
+			else if (name == "time-budget")
+			{
+				time_budget = stod(value);
+
+				if (time_budget <= 0)
+					throw invalid_argument(value);
+			}
+			else if (name == "report")
+				report_file_name = value;
+			else if (name == "threads")
+				parallel::thread_count() = max<size_t>(1, stoul(value));
+			else if (name == "normal-k")
+				normal_neighbours = stoul(value);
+			else if (name == "viewpoint")
+			{
+				char separator1, separator2;
+				istringstream value_stream(value);
+
+				if (!(value_stream >> viewpoint[0] >> separator1 >> viewpoint[1] >> separator2 >> viewpoint[2]))
+					throw invalid_argument(value);
+
+				has_viewpoint = true;
+			}
+			else
+				cout << "Unknown option " << arg << " is ignored." << endl;
+		}
+		catch (const std::exception&)
+		{
+			cout << "Invalid value in option " << arg << ". Option is ignored." << endl;
+		}
+	}
+
+	return positional_args;
+}
+
 /** @brief Processes input arguments containing filename and user defined variables (Space Interval Threshold (DT) and Normal Vector Deviation Threshold (NT)).
  *	If there are no arguments, user is asked to provide them to console.
 */
@@ -307,7 +368,7 @@ string process_args(const int argc, char* argv[])
 	{
 		file_name = argv[1];
 
-		if (file_name.length() < 5 || file_name.find(file_name_extention) == string::npos)
+		if (file_name.length() < 5 || !is_supported_file(file_name))
 		{
 			file_name += file_name_extention;
 		}
@@ -322,12 +383,20 @@ string process_args(const int argc, char* argv[])
 			cout << "Using default file name: " << default_file_name << endl;
 			file_name = default_file_name;
 		}
-		else if (file_name.length() < 5 || file_name.find(file_name_extention) == string::npos)
+		else if (file_name.length() < 5 || !is_supported_file(file_name))
 		{
 			file_name += file_name_extention;
 		}
 	}
 
+	// DT is given by levels of detail or searched for target number of points, so third argument is Normal Vector Deviation Threshold (NT)
+	if (!level_space_intervals.empty() || target_points > 0 || target_ratio > 0)
+	{
+		vector_deviation_nt = process_float_arg(argc, argv, 2, vector_deviation_var);
+
+		return file_name;
+	}
+
 	space_interval_dt = process_float_arg(argc, argv, 2, space_interval_var); // third argument is Space Interval Threshold (DT)
 
 	vector_deviation_nt = process_float_arg(argc, argv, 3, vector_deviation_var); // fourth argument is Normal Vector Deviation Threshold (NT)
@@ -335,252 +404,245 @@ string process_args(const int argc, char* argv[])
 	return file_name;
 }
 
-/** @brief Cluster is boudary if there are less less than 6 centroids in vicinity of sqrt(3) * space_interval_dt.
+/** @brief Handler of SIGINT (Ctrl+C). First interrupt cancels run, so reduced point cloud is still exported; second one terminates program.
 */
-bool is_boundary_cluster (const cluster& init_cluster, const tree& my_tree)
+extern "C" void interrupt_handler(int)
 {
-	float* centroid = cloud.points[init_cluster[0]].data; // index to centroid is at index 0 in cluster
-	const float radius = static_cast<float>(sqrt(3) * space_interval_dt);
-	vector<std::pair<size_t, float>> indices_dists;
-
-	my_tree.radiusSearch(centroid, radius, indices_dists, SearchParams());
-
-	int number_of_centroid = 0;
-
-	for (size_t i = 0; i < indices_dists.size(); ++i)
-	{
-		if (cloud.points[indices_dists[i].first].is_centroid)
-		{
-			number_of_centroid++;
-		}
-	}
-
-	// there is always one centroid from initial cluster - that one does not count to neighbouring centroids count but it is always returned from radiusSearch
-	return number_of_centroid < 7;
+	cancellation::shared_token().cancel();
+	signal(SIGINT, SIG_DFL);
 }
 
-/** @brief Returns indices to clusters which are boundary clusters.
-*/
-vector<size_t> boundary_cluster_detection(const tree& tree)
-{
-	vector<size_t> cluster_indices;
-
-	for (size_t i = 0; i < initial_clusters.size(); ++i)
-	{
-		if (is_boundary_cluster(initial_clusters[i], tree))
-		{
-			cluster_indices.push_back(i);
-		}
-	}
-
-	return cluster_indices;
-}
-
-/*
-void boundary_cluster_subdivision(const vector<int>& boundary_clusters)
-{
-	
-}*/
-
-/** @brief Standard deviation of normal vectors of 2 points. Normal vectors are expected to be normalized, therefore return value is between 0 and 1.
- *	Deviation is based on Euclidian distance
+/** @brief Wait for Enter key to be pressed. Used to prevent closing console.
 */
-float standard_deviation(const point& p1, const point& p2)
+void wait_for_enter()
 {
-	float sum = 0;
-
-	for (size_t i = 6; i < 6 + point::dimension; ++i) // normal vector coordinates are in array on indices 6, 7 and 8
-		sum += pow(p1.data[i] - p2.data[i], 2);
+	progress::shared_reporter().stop();
 
-	return sqrt(sum / 2);
+	cout << endl << endl << "Press ENTER key to exit the program...";
+	std::getchar();
 }
 
-/** @brief Returns new means (indices to cluster of pair of points with largest deviation of normal vectors).
- *	If this deviation is larger than Normal Vector Deviation Threshold (NT), cluster should be divided.
- *	Returns pair (-1, -1) as indicator if cluster should not be divided.
+/** @brief Entry point. Arguments should contain filename as string, Space Interval Threshold (DT) as float (omitted with --lod, --target-points or --target-ratio)
+ *	and normal Normal Vector Deviation Threshold (NT) as float.
+ *	DT is radius of initial clusters in units of point coordinates. Older versions searched clusters within sqrt(DT) instead,
+ *	so results for DT other than 1 differ from them (same clusters as before are given by square root of old DT).
+ *	If any of these arguments is missing or is invalid, user is asked to provide them to console.
+ *	Optional switches (see process_options) may be placed anywhere among arguments.
 */
-pair<int, int> new_means(const cluster& cluster)
+int main(const int argc, char* argv[])
 {
-	// cluster with 1 member should not be divided; cluster division can be skipped if vector_deviation_nt is too close to 1
-	if (cluster.size() <= 1 || vector_deviation_nt > 0.99999)
-		return {-1, -1};
+	vector<char*> positional_args = process_options(argc, argv);
+	string input_file_name = process_args(static_cast<int>(positional_args.size()), positional_args.data());
+
+	report.set_setting("input_file", instrumentation::json_string(input_file_name));
+	report.set_setting("space_interval_dt", to_string(space_interval_dt));
+	report.set_setting("vector_deviation_nt", to_string(vector_deviation_nt));
+	report.set_setting("threads", to_string(parallel::thread_count()));
+	report.set_setting("boundary_subdivision", boundary_subdivision ? "true" : "false");
+	record_seed_graph = boundary_subdivision; // boundary detection counts neighbouring centroids in graph recorded by initialization
+	report.set_setting("representative", mean_representatives ? "\"mean\"" : "\"seed\"");
+	report.set_setting("huge_pages", memory_placement::active().huge_pages ? "true" : "false");
+	report.set_setting("numa", instrumentation::json_string(memory_placement::policy_name(memory_placement::active().numa)));
+
+	if (use_claim_index || use_implicit_tree)
+		report.set_setting("leaf_kernel", instrumentation::json_string(leaf_kernel::active().name));
+
+	if (show_progress)
+		progress::shared_reporter().start(true, progress_file_name);
+
+	if (time_budget > 0)
+	{
+		cancellation::shared_token().set_time_budget(time_budget);
+		report.set_setting("time_budget_seconds", to_string(time_budget));
+	}
 
-	float max_deviation = 0;
-	int max_index1, max_index2;
+	signal(SIGINT, interrupt_handler);
 
-	for (size_t i = 0; i < cluster.size() - 1; ++i)
+	try
 	{
-		for (size_t j = i + 1; j < cluster.size(); ++j)
-		{
-			const float local_deviation = standard_deviation(cloud.points[cluster[i]], cloud.points[cluster[j]]);
-
-			if (local_deviation > max_deviation)
-			{
-				max_deviation = local_deviation;
-				max_index1 = static_cast<int>(i);
-				max_index2 = static_cast<int>(j);
-			}
-		}
+		instrumentation::stage_timer timer(report, "import");
+		import_point_cloud(input_file_name);
+		timer.stop(cloud.points.size());
 	}
+	catch (const std::exception& e)
+	{
+		cout << endl << endl << "Error! File " + input_file_name + " was not successfully imported or parsed! (" << e.what() << ")";
 
-	if (max_deviation >= vector_deviation_nt)
-		return { max_index1, max_index2 }; // indices to cluster of pair of points with largest deviation of normal vectors 
-	else
-		return { -1, -1 }; // indicator that cluster should not be divided
-}
+		wait_for_enter();
 
-/** @brief Simplified k-means clustering algorithm with k=2, non-moving predetermined centroid and 1 iteration.
-*/
-pair<cluster, cluster> k_means_clustering(const cluster& init_cluster, const pair<int, int>& means)
-{
-	cluster temp1, temp2;
+		return -1;
+	}
 
-	temp1.push_back(init_cluster[means.first]);
-	temp2.push_back(init_cluster[means.second]);
+	progress::shared_reporter().begin_stage("index_build", cloud.points.size(), "points");
+	cout << "Building K-D tree." << endl;
+	instrumentation::stage_timer index_timer(report, "index_build");
+	tree tree(point::dimension, cloud, KDTreeSingleIndexAdaptorParams(50));
+	tree.buildIndex();
+	progress::shared_reporter().set(cloud.points.size()); // nanoflann does not report progress of build
+	index_timer.stop(cloud.points.size());
 
-	for (size_t i = 0; i < init_cluster.size(); ++i)
+	if (leaf_order)
 	{
-		if (static_cast<int>(i) == means.first || static_cast<int>(i) == means.second) // means are already at beginnings of temporary clusters
-			continue;
-
-		const double distance_to_mean1 = cloud.points[init_cluster[i]].distance(cloud.points[init_cluster[means.first]]);
-		const double distance_to_mean2 = cloud.points[init_cluster[i]].distance(cloud.points[init_cluster[means.second]]);
-
-		if (distance_to_mean1 < distance_to_mean2)
-			temp1.push_back(init_cluster[i]);
-		else
-			temp2.push_back(init_cluster[i]);
+		instrumentation::stage_timer timer(report, "leaf_order");
+		leaf_order_stage(tree);
+		timer.stop(cloud.points.size());
 	}
 
-	return { temp1, temp2 };
-}
+	if (!level_space_intervals.empty())
+	{
+		string levels;
 
-/** @brief Decides whether cluster should be divided. If yes, it is recursively divided using k-means. If no, it is added to new_clusters.
-*/
-void recursive_cluster_subdivision(const cluster& init_cluster)
-{
-	const pair<int, int> means = new_means(init_cluster);
+		for (size_t i = 0; i < level_space_intervals.size(); ++i)
+			levels += (i ? ", " : "") + to_string(level_space_intervals[i]);
 
-	if (means.first == -1 || means.second == -1) // cluster should not be divided anymore
+		report.set_setting("levels_of_detail", "[" + levels + "]");
+	}
+	else if (target_points > 0 || target_ratio > 0)
 	{
-		new_clusters.push_back(init_cluster);
+		if (target_points == 0)
+			target_points = static_cast<size_t>(target_ratio * cloud.points.size() + 0.5);
+
+		instrumentation::stage_timer timer(report, "space_interval_search");
+		space_interval_dt = space_interval_search_stage(tree, target_points);
+		timer.stop(cloud.points.size());
+
+		report.set_setting("target_points", to_string(target_points));
+		report.set_setting("space_interval_dt", to_string(space_interval_dt));
 	}
-	else // recursively divide cluster
+
+	if (!cloud.has_normals)
 	{
-		const pair<cluster, cluster> divided_clusters = k_means_clustering(init_cluster, means);
+		try
+		{
+			instrumentation::stage_timer timer(report, "normal_estimation");
+			normal_estimation_stage(tree);
+			timer.stop(cloud.points.size());
+		}
+		catch (const cancellation::cancelled_error&)
+		{
+			cout << endl << endl << "Error! Run was cancelled before normal vectors were estimated.";
 
-		// means became new centroids for new clusters
-		cloud.points[init_cluster[0]].is_centroid = false;
-		cloud.points[init_cluster[means.first]].is_centroid = true;
-		cloud.points[init_cluster[means.second]].is_centroid = true;
+			wait_for_enter();
 
-		// recursion
-		recursive_cluster_subdivision(divided_clusters.first);
-		recursive_cluster_subdivision(divided_clusters.second);
+			return -1;
+		}
 	}
-}
 
-/** @brief Calls subdivision on all clusters.
-*/
-void main_cluster_subdivision()
-{
-	cout << "Dividing clusters." << endl;
+	// without --lod there is single level with DT from arguments (or found for target number of points)
+	const vector<float> levels = level_space_intervals.empty() ? vector<float>{ space_interval_dt } : level_space_intervals;
+	const string base_file_name = input_file_name.substr(0, input_file_name.size() - 4);
+	string level_output_points;
+	string level_statistics; // subdivision statistics of every level (statistics are cleared before next level)
 
-	for (size_t i = 0; i < initial_clusters.size(); ++i)
-		recursive_cluster_subdivision(initial_clusters[i]);
-}
+	for (size_t level = 0; level < levels.size(); ++level)
+	{
+		space_interval_dt = levels[level];
 
-/** @brief Exports centroid from new_clusters. Exported file has same header and format as input file.
-*/
-void export_point_cloud(const string& output_file_name)
-{
-	ofstream output_file(output_file_name);
+		const string level_suffix = level_space_intervals.empty() ? "" : "_lod" + to_string(level); // for names of stages in report
 
-	cout << "Exporting reduced point cloud to file: " + output_file_name << endl;
+		if (!level_space_intervals.empty())
+			cout << endl << "Level of detail " << level << " (Space Interval Threshold (DT) " << space_interval_dt << ")." << endl;
 
-	// write header
-	output_file << "ply"<< endl << "format ascii 1.0" << endl << "element vertex " << new_clusters.size() << endl;
-	output_file << "property float x" << endl << "property float y" << endl << "property float z" << endl;
-	output_file << "property uchar red" << endl << "property uchar green" << endl << "property uchar blue" << endl;
-	output_file << "property float nx" << endl << "property float ny" << endl << "property float nz" << endl;
-	output_file << "end_header" << endl;
+		instrumentation::stage_timer initialization_timer(report, "initialization" + level_suffix);
 
-	for (size_t i = 0; i < new_clusters.size(); ++i)
-	{
-		stringstream line_stream; // for simple buffering		
+		if (level == 0)
+			cluster_initialization(tree);
+		else
+			level_of_detail_initialization(); // coarser level is built from centroids of previous level
 
-		for (size_t j = 0; j < 9; ++j)
+		initialization_timer.stop(cloud.points.size(), initial_clusters.size());
+
+		if (boundary_subdivision)
 		{
-			// goes through all clusters, takes points from index 0 (centroid of that cluster) and writes its array elements (coordinates, color and normal vectors)
-			line_stream << std::setprecision(7) << cloud.points[new_clusters[i][0]].data[j];
+			instrumentation::stage_timer detection_timer(report, "boundary_detection" + level_suffix);
+			const vector<size_t> boundary_clusters_indices = boundary_cluster_detection();
+			detection_timer.stop(initial_clusters.size(), boundary_clusters_indices.size());
 
-			if (j < 8)
-				line_stream << ' ';
+			instrumentation::stage_timer subdivision_timer(report, "boundary_subdivision" + level_suffix);
+			boundary_cluster_subdivision(boundary_clusters_indices);
+			subdivision_timer.stop(cloud.points.size(), initial_clusters.size());
 		}
 
-		output_file << line_stream.rdbuf() << endl;
-	}
+		instrumentation::stage_timer subdivision_timer(report, "subdivision" + level_suffix);
+		main_cluster_subdivision();
+		subdivision_timer.stop(cloud.points.size(), new_clusters.size());
 
-	cout << endl << endl << "Point cloud was reduced from " << cloud.points.size() << " points to " << new_clusters.size() << " points." << endl;
-	cout << "That is " << new_clusters.size() / static_cast<float>(cloud.points.size()) * 100 << "%.";
-}
+		if (statistics.enabled)
+			level_statistics += (level ? ", " : "") + statistics.to_json();
 
-/** @brief Wait for Enter key to be pressed. Used to prevent closing console.
-*/
-void wait_for_enter()
-{
-	cout << endl << endl << "Press ENTER key to exit the program...";
-	std::getchar();
-}
+		const string output_file_name = level_space_intervals.empty()
+			? base_file_name + modified_file_suffix + file_name_extention
+			: base_file_name + level_of_detail_suffix + to_string(level) + file_name_extention;
 
-/** @brief Entry point. Arguments should contain filename as string, Space Interval Threshold (DT) as float 
- *	and normal Normal Vector Deviation Threshold (NT) as float.
- *	If any of these arguments is missing or is invalid, user is asked to provide them to console.
-*/
-int main(const int argc, char* argv[])
-{
-	string input_file_name = process_args(argc, argv);
-
-	try
-	{
-		import_point_cloud(input_file_name);
-	}
-	catch (const std::exception&)
-	{
-		cout << endl << endl << "Error! File " + input_file_name + " was not successfully imported or parsed!";
-
-		wait_for_enter();
+		try
+		{
+			instrumentation::stage_timer timer(report, "export" + level_suffix);
+			export_point_cloud(output_file_name);
+			timer.stop(new_clusters.size(), new_clusters.size());
+		}
+		catch (const std::exception&)
+		{
+			cout << endl << endl << "Error! Could not write to output file (" + output_file_name + ").";
 
-		return -1;
-	}
+			wait_for_enter();
 
-	cout << "Building K-D tree." << endl;
-	tree tree(point::dimension, cloud, KDTreeSingleIndexAdaptorParams(50));
-	tree.buildIndex();
+			return -1;
+		}
 
-	cluster_initialization(tree);
+		if (octree_node_points > 0)
+		{
+			const string octree_base_name = output_file_name.substr(0, output_file_name.size() - file_name_extention.size());
 
-	//const vector<size_t> boundary_clusters_indices = boundary_cluster_detection(tree);
-	//boundary_cluster_subdivision(boundary_clusters);
+			try
+			{
+				instrumentation::stage_timer timer(report, "octree_export" + level_suffix);
+				export_octree(octree_base_name + octree_file_name_extention, octree_base_name + octree_index_file_name_extention, octree_node_points);
+				timer.stop(new_clusters.size(), new_clusters.size());
+			}
+			catch (const std::exception& e)
+			{
+				cout << endl << endl << "Error! Octree tiles were not written (" << e.what() << ").";
 
-	main_cluster_subdivision();
+				wait_for_enter();
 
-	const string output_file_name = input_file_name.substr(0, input_file_name.size() - 4) + modified_file_suffix + file_name_extention;
+				return -1;
+			}
+		}
 
-	try
-	{
-		export_point_cloud(output_file_name);
+		level_output_points += (level ? ", " : "") + to_string(new_clusters.size());
 	}
-	catch (const std::exception&)
+
+	if (!report_file_name.empty())
 	{
-		cout << endl << endl << "Error! Could not write to output file (" + output_file_name + ").";
+		report.set_summary("input_points", to_string(cloud.points.size()));
+		report.set_summary("output_points", to_string(new_clusters.size()));
+		if (!level_space_intervals.empty())
+			report.set_summary("level_output_points", "[" + level_output_points + "]");
 
-		wait_for_enter();
+		report.set_summary("cancelled", cancellation::shared_token().is_cancelled() ? "true" : "false");
 
-		return -1;
+		if (time_budget > 0)
+			report.set_summary("budget_overrun_seconds", to_string(cancellation::shared_token().overrun_seconds()));
+
+		report.set_summary("huge_page_bytes", to_string(memory_placement::huge_page_bytes())); // anonymous memory backed by huge pages at end of run
+		report.set_summary("numa_placement", instrumentation::json_string(memory_placement::numa_status()));
+
+		if (statistics.enabled && level_space_intervals.empty())
+			report.set_summary("subdivision_statistics", statistics.to_json());
+		else if (statistics.enabled)
+			report.set_summary("level_subdivision_statistics", "[" + level_statistics + "]");
+
+		try
+		{
+			report.write_json(report_file_name);
+		}
+		catch (const std::exception& e)
+		{
+			cout << endl << "Warning! Report was not written (" << e.what() << ").";
+		}
 	}
 
 	wait_for_enter();
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,71 @@
+#include <cstdlib>
+#include <new>
+#include "instrumentation.hpp"
+
+using namespace std;
+
+/** @brief Replacement of global operator new and delete which counts heap allocations for run report (see instrumentation::allocations).
+ *	Replacement changes allocator of whole program, so this file is linked into command line tool and benchmark only (not into optimizer library).
+*/
+
+namespace
+{
+	const bool is_linked = (instrumentation::counts_allocations() = true);
+}
+
+void* operator new(size_t size)
+{
+	instrumentation::allocations().fetch_add(1, memory_order_relaxed);
+
+	if (void* memory = malloc(size ? size : 1))
+		return memory;
+
+	throw bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	instrumentation::allocations().fetch_add(1, memory_order_relaxed);
+
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, const nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, const nothrow_t&) noexcept
+{
+	free(memory);
+}
@@ -0,0 +1,183 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/** @brief Monotonic arenas for transient data of stages (search buffers, temporary parts of clusters during subdivision).
+ *	Arena hands out memory by bumping offset in large blocks and does not free single allocations (except the last one),
+ *	so many small temporary vectors cost few block allocations instead of heap allocation each.
+ *	Everything allocated after scope was opened is released at once when scope ends (see scope).
+ *	Every thread has its own arena (see local), so allocations need no locking. Arena of worker thread is freed when thread ends.
+*/
+namespace arena
+{
+	class monotonic
+	{
+	public:
+		static const size_t block_size = size_t(1) << 20; // larger allocations get block of their own
+
+		monotonic() = default;
+		monotonic(const monotonic&) = delete;
+		monotonic& operator=(const monotonic&) = delete;
+
+		~monotonic()
+		{
+			release(0);
+		}
+
+		void* allocate(const size_t bytes, const size_t alignment)
+		{
+			if (!blocks.empty())
+			{
+				const size_t offset = (used + alignment - 1) / alignment * alignment;
+
+				if (offset + bytes <= blocks[current].size)
+				{
+					used = offset + bytes;
+					return blocks[current].data + offset;
+				}
+			}
+
+			// next block (kept from before last rewind) if it is large enough, otherwise new block
+			const size_t next = blocks.empty() ? 0 : current + 1;
+
+			if (next == blocks.size() || blocks[next].size < bytes)
+			{
+				const size_t size = bytes > block_size ? bytes : block_size;
+				blocks.insert(blocks.begin() + next, block{ static_cast<char*>(::operator new(size)), size }); // aligned for any type
+			}
+
+			current = next;
+			used = bytes;
+
+			return blocks[current].data;
+		}
+
+		/** @brief Returns memory of last allocation to arena (other allocations are released by scope only).
+		*/
+		void deallocate(void* memory, const size_t bytes)
+		{
+			if (!blocks.empty() && static_cast<char*>(memory) + bytes == blocks[current].data + used)
+				used -= bytes;
+		}
+
+	private:
+		friend class scope;
+
+		struct block
+		{
+			char* data;
+			size_t size;
+		};
+
+		std::vector<block> blocks;
+		size_t current = 0; // block in use
+		size_t used = 0; // bytes used in current block
+		size_t depth = 0; // number of open scopes
+
+		/** @brief Frees all blocks except first kept ones and starts from beginning of first block.
+		*/
+		void release(const size_t kept)
+		{
+			for (size_t i = kept; i < blocks.size(); ++i)
+				::operator delete(blocks[i].data);
+
+			blocks.resize(std::min(kept, blocks.size()));
+			current = 0;
+			used = 0;
+		}
+	};
+
+	/** @brief Arena of calling thread.
+	*/
+	inline monotonic& local()
+	{
+		static thread_local monotonic instance;
+		return instance;
+	}
+
+	/** @brief Opens scope in arena of calling thread. Memory allocated in arena while scope is open is released when scope ends.
+	 *	Outermost scope of thread (e.g. one per chunk of parallel loop or per cluster) also frees all blocks except first one,
+	 *	so arena does not keep memory of one stage in next one.
+	*/
+	class scope
+	{
+	public:
+		scope() : memory(local()), block(memory.current), used(memory.used)
+		{
+			memory.depth++;
+		}
+
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+
+		~scope()
+		{
+			if (--memory.depth == 0)
+				memory.release(1);
+			else
+			{
+				memory.current = block;
+				memory.used = used;
+			}
+		}
+
+	private:
+		monotonic& memory;
+		const size_t block;
+		const size_t used;
+	};
+
+	/** @brief Allocator of standard containers taking memory from arena of thread which constructed it.
+	 *	Container must not outlive scope in which it was created.
+	*/
+	template <typename T>
+	class allocator
+	{
+	public:
+		typedef T value_type;
+
+		allocator() : memory(&local())
+		{
+		}
+
+		template <typename U>
+		allocator(const allocator<U>& other) : memory(other.memory)
+		{
+		}
+
+		T* allocate(const size_t n)
+		{
+			return static_cast<T*>(memory->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* pointer, const size_t n)
+		{
+			memory->deallocate(pointer, n * sizeof(T));
+		}
+
+		template <typename U>
+		bool operator==(const allocator<U>& other) const
+		{
+			return memory == other.memory;
+		}
+
+		template <typename U>
+		bool operator!=(const allocator<U>& other) const
+		{
+			return memory != other.memory;
+		}
+
+	private:
+		template <typename U>
+		friend class allocator;
+
+		monotonic* memory;
+	};
+
+	template <typename T>
+	using vector = std::vector<T, allocator<T>>;
+}
+#endif // ARENA_HPP
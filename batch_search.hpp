@@ -0,0 +1,185 @@
+#ifndef BATCH_SEARCH_HPP
+#define BATCH_SEARCH_HPP
+#include "arena.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** @brief Batched queries of nanoflann K-D tree: block of spatially close query points traverses tree once instead of every query
+ *	descending from root on its own. Node is skipped for whole block if it is farther from bounding box of block than worst distance
+ *	of all its queries, otherwise only queries which are close enough to node continue to its children.
+ *	Queries are independent, so results are same as results of findNeighbors of nanoflann for every query alone
+ *	(except order of neighbours with equal distance, which depends on order of visited leaves).
+*/
+namespace batch_search
+{
+	// queries of one block (32 consecutive points in order of leaves of tree are within one or two leaves)
+	const size_t default_batch_size = 32;
+
+	/** @brief Searcher of one tree with buffers reused by all its batches. Every thread needs its own searcher.
+	 *	Buffers are allocated in arena of thread which constructed searcher.
+	*/
+	template <typename Tree>
+	class searcher
+	{
+	public:
+		explicit searcher(const Tree& searched_tree) : tree(searched_tree)
+		{
+		}
+
+		/** @brief Finds neighbours of queries[0] to queries[number_of_queries - 1] (coordinates of points) and adds them to result_sets
+		 *	(result sets of nanoflann, e.g. KNNResultSet, or any class with same addPoint and worstDist).
+		 *	Query stops receiving points when its addPoint returns false.
+		*/
+		template <typename ResultSet>
+		void find_neighbours(const float* const* queries, const size_t number_of_queries, ResultSet* result_sets)
+		{
+			if (!tree.root_node || number_of_queries == 0)
+				return;
+
+			query_points = queries;
+			is_stopped.assign(number_of_queries, 0);
+			active.clear();
+
+			for (size_t q = 0; q < number_of_queries; ++q)
+				active.push_back(static_cast<uint32_t>(q));
+
+			float min[3], max[3];
+
+			for (int d = 0; d < 3; ++d)
+			{
+				min[d] = tree.root_bbox[d].low;
+				max[d] = tree.root_bbox[d].high;
+			}
+
+			search_node(tree.root_node, min, max, 0, active.size(), result_sets);
+		}
+
+	private:
+		const Tree& tree;
+		const float* const* query_points = nullptr;
+		arena::vector<char> is_stopped;
+		arena::vector<uint32_t> active; // stack of lists of queries active in nodes on path from root (list of node follows list of its parent)
+
+		static float box_distance(const float* query, const float min[3], const float max[3])
+		{
+			float distance = 0;
+
+			for (int d = 0; d < 3; ++d)
+			{
+				const float outside = query[d] < min[d] ? min[d] - query[d] : (query[d] > max[d] ? query[d] - max[d] : 0);
+				distance += outside * outside;
+			}
+
+			return distance;
+		}
+
+		/** @brief Visits node with bounding box (min, max) with queries active[begin] to active[end - 1] of its parent.
+		*/
+		template <typename Node, typename ResultSet>
+		void search_node(const Node* node, const float min[3], const float max[3], const size_t begin, const size_t end, ResultSet* result_sets)
+		{
+			// bounding box of queries and their largest worst distance reject node for whole block at once
+			float block_min[3], block_max[3];
+			float worst_distance = 0;
+
+			for (int d = 0; d < 3; ++d)
+			{
+				block_min[d] = query_points[active[begin]][d];
+				block_max[d] = block_min[d];
+			}
+
+			for (size_t k = begin; k < end; ++k)
+			{
+				const float* query = query_points[active[k]];
+
+				for (int d = 0; d < 3; ++d)
+				{
+					block_min[d] = std::min(block_min[d], query[d]);
+					block_max[d] = std::max(block_max[d], query[d]);
+				}
+
+				worst_distance = std::max(worst_distance, static_cast<float>(result_sets[active[k]].worstDist()));
+			}
+
+			float gap = 0;
+
+			for (int d = 0; d < 3; ++d)
+			{
+				const float outside = std::max(0.0f, std::max(min[d] - block_max[d], block_min[d] - max[d]));
+				gap += outside * outside;
+			}
+
+			if (gap >= worst_distance)
+				return;
+
+			// queries close enough to node are appended after list of parent
+			const size_t node_begin = active.size();
+
+			for (size_t k = begin; k < end; ++k)
+			{
+				const uint32_t q = active[k];
+
+				if (!is_stopped[q] && box_distance(query_points[q], min, max) < result_sets[q].worstDist())
+					active.push_back(q);
+			}
+
+			const size_t node_end = active.size();
+
+			if (node_begin == node_end)
+				return;
+
+			if (!node->child1 && !node->child2) // leaf
+			{
+				for (size_t k = node_begin; k < node_end; ++k)
+				{
+					const uint32_t q = active[k];
+					const float* query = query_points[q];
+
+					for (size_t i = node->node_type.lr.left; i < node->node_type.lr.right && !is_stopped[q]; ++i)
+					{
+						const auto index = tree.vind[i];
+						float distance = 0;
+
+						for (int d = 0; d < 3; ++d) // same order of operations as L2_Simple_Adaptor of nanoflann
+						{
+							const float difference = query[d] - tree.dataset.kdtree_get_pt(index, d);
+							distance += difference * difference;
+						}
+
+						if (distance < result_sets[q].worstDist() && !result_sets[q].addPoint(distance, index))
+							is_stopped[q] = 1;
+					}
+				}
+			}
+			else
+			{
+				const int axis = node->node_type.sub.divfeat;
+
+				float low_max[3] = { max[0], max[1], max[2] }; // bounding box of child1 ends at divlow
+				float high_min[3] = { min[0], min[1], min[2] }; // bounding box of child2 starts at divhigh
+				low_max[axis] = static_cast<float>(node->node_type.sub.divlow);
+				high_min[axis] = static_cast<float>(node->node_type.sub.divhigh);
+
+				// child closer to centre of block first, so worst distances shrink sooner
+				const float block_centre = (block_min[axis] + block_max[axis]) / 2;
+				const bool low_first = block_centre - low_max[axis] < high_min[axis] - block_centre;
+
+				if (low_first)
+				{
+					search_node(node->child1, min, low_max, node_begin, node_end, result_sets);
+					search_node(node->child2, high_min, max, node_begin, node_end, result_sets);
+				}
+				else
+				{
+					search_node(node->child2, high_min, max, node_begin, node_end, result_sets);
+					search_node(node->child1, min, low_max, node_begin, node_end, result_sets);
+				}
+			}
+
+			active.resize(node_begin);
+		}
+	};
+}
+#endif // BATCH_SEARCH_HPP
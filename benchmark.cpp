@@ -0,0 +1,301 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "rply.h"
+#include "optimizer.hpp"
+#include "parallel.hpp"
+#include "synthetic_cloud.hpp"
+#include "instrumentation.hpp"
+
+using namespace std;
+using namespace nanoflann;
+
+// stages of pipeline timed by benchmark (in order of execution)
+const vector<string> stage_names = { "import_point_cloud", "buildIndex", "cluster_initialization", "main_cluster_subdivision", "export_point_cloud" };
+
+vector<string> generators = { "plane", "sphere", "noisy_scan", "heavy_tailed" };
+vector<size_t> sizes = { 100000, 1000000 };
+vector<float> dt_values = { 0.5f, 1 };
+vector<float> nt_values = { 0.5f };
+size_t repetitions = 5; // timed runs of every configuration; median is reported
+size_t warmup_runs = 1; // untimed runs before timed runs
+bool ascii_input = false;
+bool keep_files = false;
+string report_file_name;
+
+/** @brief Measured configuration (generator, size, DT, NT) with median and minimum of every stage over all repetitions.
+*/
+struct benchmark_result
+{
+	string generator;
+	size_t points;
+	float dt, nt;
+	size_t output_points;
+	vector<double> median_seconds;
+	vector<double> min_seconds;
+};
+
+/** @brief Splits comma separated list and converts its items.
+*/
+template <typename T, typename Convert>
+vector<T> parse_list(const string& value, const Convert& convert)
+{
+	vector<T> items;
+	stringstream value_stream(value);
+	string item;
+
+	while (getline(value_stream, item, ','))
+	{
+		if (!item.empty())
+			items.push_back(convert(item));
+	}
+
+	if (items.empty())
+		throw invalid_argument(value);
+
+	return items;
+}
+
+/** @brief Processes switches in form --name=value. Sizes may be written in scientific notation (e.g. --sizes=1e5,1e6,1e7).
+*/
+bool process_args(const int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg(argv[i]);
+		const size_t equals = arg.find('=');
+		const string name = arg.substr(0, equals);
+		const string value = equals == string::npos ? "" : arg.substr(equals + 1);
+
+		try
+		{
+			if (name == "--generators")
+				generators = parse_list<string>(value, [](const string& item) { return item; });
+			else if (name == "--sizes")
+				sizes = parse_list<size_t>(value, [](const string& item) { return static_cast<size_t>(stod(item)); });
+			else if (name == "--dt")
+				dt_values = parse_list<float>(value, [](const string& item) { return stof(item); });
+			else if (name == "--nt")
+				nt_values = parse_list<float>(value, [](const string& item) { return stof(item); });
+			else if (name == "--repeat")
+				repetitions = max<size_t>(1, stoul(value));
+			else if (name == "--warmup")
+				warmup_runs = stoul(value);
+			else if (name == "--threads")
+				parallel::thread_count() = max<size_t>(1, stoul(value));
+			else if (name == "--ascii")
+				ascii_input = true;
+			else if (name == "--keep-files")
+				keep_files = true;
+			else if (name == "--report")
+				report_file_name = value;
+			else
+			{
+				cerr << "Unknown argument " << arg << endl;
+				return false;
+			}
+		}
+		catch (const std::exception&)
+		{
+			cerr << "Invalid value in argument " << arg << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** @brief Writes synthetic cloud to .ply file with same structure as files accepted by optimizer.
+*/
+void write_ply(const string& file_name, const point_cloud<float>& source)
+{
+	const p_ply ply = ply_create(file_name.c_str(), ascii_input ? PLY_ASCII : PLY_LITTLE_ENDIAN, nullptr, 0, nullptr);
+
+	if (!ply)
+		throw runtime_error("Could not create file " + file_name);
+
+	const char* names[9] = { "x", "y", "z", "red", "green", "blue", "nx", "ny", "nz" };
+	ply_add_element(ply, "vertex", static_cast<long>(source.points.size()));
+
+	for (size_t i = 0; i < 9; ++i)
+		ply_add_scalar_property(ply, names[i], i >= 3 && i < 6 ? PLY_UCHAR : PLY_FLOAT);
+
+	ply_write_header(ply);
+
+	for (const point& p : source.points)
+	{
+		for (size_t i = 0; i < 9; ++i)
+			ply_write(ply, p.data[i]);
+	}
+
+	ply_close(ply);
+}
+
+double median(vector<double> values)
+{
+	sort(values.begin(), values.end());
+	const size_t middle = values.size() / 2;
+
+	return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+/** @brief Runs whole pipeline once and returns duration of every stage in seconds.
+*/
+vector<double> run_pipeline(const string& input_file_name, const string& output_file_name)
+{
+	vector<double> seconds;
+	auto start = chrono::steady_clock::now();
+
+	auto lap = [&seconds, &start]()
+	{
+		const auto now = chrono::steady_clock::now();
+		seconds.push_back(chrono::duration<double>(now - start).count());
+		start = now;
+	};
+
+	reset_optimizer();
+	start = chrono::steady_clock::now();
+
+	import_point_cloud(input_file_name);
+	lap();
+
+	tree tree(point::dimension, cloud, KDTreeSingleIndexAdaptorParams(50));
+	tree.buildIndex();
+	lap();
+
+	cluster_initialization(tree);
+	lap();
+
+	main_cluster_subdivision();
+	lap();
+
+	export_point_cloud(output_file_name);
+	lap();
+
+	return seconds;
+}
+
+/** @brief Benchmark of optimization pipeline on synthetic point clouds.
+ *	Every combination of generator, size, DT and NT is run (warmup + repeat) times and median and minimum of every stage is reported.
+ *	Progress messages of stages are suppressed; results are printed as table and optionally written as JSON (--report=path).
+*/
+int main(const int argc, char* argv[])
+{
+	if (!process_args(argc, argv))
+	{
+		cerr << "Usage: benchmark [--generators=plane,sphere,noisy_scan,heavy_tailed] [--sizes=1e5,1e6] [--dt=0.5,1] [--nt=0.5]" << endl
+			<< "                 [--repeat=5] [--warmup=1] [--threads=N] [--ascii] [--keep-files] [--report=file.json]" << endl;
+		return -1;
+	}
+
+	vector<benchmark_result> results;
+	ostringstream suppressed_output;
+	streambuf* const console = cout.rdbuf();
+
+	cout << left << setw(14) << "generator" << right << setw(11) << "points" << setw(7) << "DT" << setw(6) << "NT";
+
+	for (const string& stage : stage_names)
+		cout << setw(max<int>(12, static_cast<int>(stage.size()) + 2)) << stage;
+
+	cout << setw(11) << "output" << endl;
+
+	for (const string& generator : generators)
+	{
+		for (const size_t size : sizes)
+		{
+			const string input_file_name = "benchmark_" + generator + "_" + to_string(size) + file_name_extention;
+			const string output_file_name = "benchmark_" + generator + "_" + to_string(size) + "_REDUCED" + file_name_extention;
+
+			try
+			{
+				point_cloud<float> source;
+				synthetic_cloud::generate(generator, source, size, 42);
+				write_ply(input_file_name, source);
+			}
+			catch (const std::exception& e)
+			{
+				cerr << e.what() << endl;
+				return -1;
+			}
+
+			for (const float dt : dt_values)
+			{
+				for (const float nt : nt_values)
+				{
+					space_interval_dt = dt;
+					vector_deviation_nt = nt;
+
+					vector<vector<double>> stage_seconds(stage_names.size());
+
+					for (size_t run = 0; run < warmup_runs + repetitions; ++run)
+					{
+						cout.rdbuf(suppressed_output.rdbuf());
+						const vector<double> seconds = run_pipeline(input_file_name, output_file_name);
+						cout.rdbuf(console);
+						suppressed_output.str("");
+
+						if (run < warmup_runs)
+							continue;
+
+						for (size_t i = 0; i < seconds.size(); ++i)
+							stage_seconds[i].push_back(seconds[i]);
+					}
+
+					benchmark_result result{ generator, size, dt, nt, new_clusters.size(), {}, {} };
+
+					cout << left << setw(14) << generator << right << setw(11) << size << setw(7) << dt << setw(6) << nt << fixed << setprecision(1);
+
+					for (size_t i = 0; i < stage_names.size(); ++i)
+					{
+						result.median_seconds.push_back(median(stage_seconds[i]));
+						result.min_seconds.push_back(*min_element(stage_seconds[i].begin(), stage_seconds[i].end()));
+
+						cout << setw(max<int>(12, static_cast<int>(stage_names[i].size()) + 2)) << result.median_seconds[i] * 1000;
+					}
+
+					cout << setw(11) << result.output_points << defaultfloat << setprecision(6) << endl;
+					results.push_back(result);
+				}
+			}
+
+			if (!keep_files)
+			{
+				remove(input_file_name.c_str());
+				remove(output_file_name.c_str());
+			}
+		}
+	}
+
+	cout << endl << "Times are medians in milliseconds over " << repetitions << " runs." << endl;
+
+	if (!report_file_name.empty())
+	{
+		ofstream report(report_file_name);
+		report << setprecision(9) << "{\n  \"threads\": " << parallel::thread_count() << ", \"repetitions\": " << repetitions << ",\n  \"results\": [";
+
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const benchmark_result& result = results[i];
+			report << (i ? "," : "") << "\n    { \"generator\": " << instrumentation::json_string(result.generator) << ", \"points\": " << result.points
+				<< ", \"dt\": " << result.dt << ", \"nt\": " << result.nt << ", \"output_points\": " << result.output_points << ", \"stages\": {";
+
+			for (size_t j = 0; j < stage_names.size(); ++j)
+			{
+				report << (j ? ", " : " ") << instrumentation::json_string(stage_names[j]) << ": { \"median_seconds\": " << result.median_seconds[j]
+					<< ", \"min_seconds\": " << result.min_seconds[j] << " }";
+			}
+
+			report << " } }";
+		}
+
+		report << "\n  ]\n}\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+#ifndef CANCELLATION_HPP
+#define CANCELLATION_HPP
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+/** @brief Cooperative cancellation of optimization run. Cancellation is requested explicitly (e.g. from signal handler)
+ *	or by expiration of time budget. Stages poll token in their loops and either finish early with best available result
+ *	or throw cancellation::cancelled_error if they cannot produce any result.
+*/
+namespace cancellation
+{
+	class cancelled_error : public std::runtime_error
+	{
+	public:
+		cancelled_error() : std::runtime_error("run was cancelled")
+		{
+		}
+	};
+
+	class token
+	{
+	public:
+		/** @brief Requests cancellation. Safe to call from signal handler and from any thread.
+		*/
+		void cancel()
+		{
+			requested.store(true, std::memory_order_relaxed);
+		}
+
+		/** @brief Run is cancelled when given number of seconds elapses from now.
+		*/
+		void set_time_budget(const double seconds)
+		{
+			deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+			has_deadline = true;
+		}
+
+		/** @brief Keeps given number of seconds at end of time budget for work which cannot be cancelled (export of result),
+		 *	so run is cancelled that much earlier. Stages update reserve as size of their result changes.
+		*/
+		void reserve(const double seconds)
+		{
+			reserved_ticks.store(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds)).count(), std::memory_order_relaxed);
+		}
+
+		bool has_time_budget() const
+		{
+			return has_deadline;
+		}
+
+		/** @brief True if run was cancelled explicitly or its deadline has already been noticed by is_cancelled.
+		*/
+		bool is_requested() const
+		{
+			return requested.load(std::memory_order_relaxed);
+		}
+
+		/** @brief Seconds by which run has exceeded its time budget so far (0 if it has not or if there is no budget).
+		*/
+		double overrun_seconds() const
+		{
+			if (!has_deadline)
+				return 0;
+
+			const double overrun = std::chrono::duration<double>(std::chrono::steady_clock::now() - deadline).count();
+			return overrun > 0 ? overrun : 0;
+		}
+
+		bool is_cancelled()
+		{
+			if (requested.load(std::memory_order_relaxed))
+				return true;
+
+			const std::chrono::steady_clock::duration reserved(reserved_ticks.load(std::memory_order_relaxed));
+
+			if (has_deadline && std::chrono::steady_clock::now() + reserved >= deadline)
+			{
+				cancel();
+				return true;
+			}
+
+			return false;
+		}
+
+		void throw_if_cancelled()
+		{
+			if (is_cancelled())
+				throw cancelled_error();
+		}
+
+		void reset()
+		{
+			requested.store(false, std::memory_order_relaxed);
+			reserved_ticks.store(0, std::memory_order_relaxed);
+			has_deadline = false;
+		}
+
+	private:
+		std::atomic<bool> requested{ false };
+		std::atomic<std::chrono::steady_clock::rep> reserved_ticks{ 0 }; // time kept at end of budget (see reserve)
+		bool has_deadline = false;
+		std::chrono::steady_clock::time_point deadline;
+	};
+
+	/** @brief Token shared by stages and readers of this process.
+	*/
+	inline token& shared_token()
+	{
+		static token instance;
+		return instance;
+	}
+}
+#endif // CANCELLATION_HPP
@@ -0,0 +1,238 @@
+#ifndef CLAIM_INDEX_HPP
+#define CLAIM_INDEX_HPP
+#include "leaf_kernel.hpp"
+#include "memory_placement.hpp"
+#include "nanoflann.hpp"
+#include "point_cloud.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/** @brief K-D tree over points of cloud which knows which points were already claimed by some cluster.
+ *	Every leaf keeps number of its unclaimed points and every inner node number of its children with unclaimed points,
+ *	so radius search skips subtrees whose points are all claimed and returns only unclaimed points.
+ *	Claiming point changes only its leaf, unless leaf becomes fully claimed, so claims cost amortized constant time.
+ *	Search results are sorted by distance, as results of radiusSearch of nanoflann.
+ *	Index mirrors nodes of already built nanoflann K-D tree and adds bounding box and unclaimed count to each of them.
+ *	Coordinates are copied in order of leaves as structure of arrays, so every leaf is tested by SIMD leaf kernel at once (see leaf_kernel).
+ *	Index is not thread-safe (searches share buffers of leaf kernel).
+*/
+class claim_index
+{
+public:
+	explicit claim_index(const point_cloud<float>& source_cloud) : cloud(source_cloud), scan(leaf_kernel::active().scan)
+	{
+	}
+
+	/** @brief Builds index with same structure as given (built) nanoflann K-D tree over whole cloud, so points do not have to be partitioned again.
+	*/
+	template <typename Tree>
+	void build(const Tree& tree)
+	{
+		const size_t n = cloud.points.size();
+
+		nodes.clear();
+		parents.clear();
+		remaining.clear();
+		memory_placement::reserve(order, n);
+		memory_placement::reserve(leaf_of_point, n);
+		order.assign(tree.vind.begin(), tree.vind.end());
+		leaf_of_point.assign(n, -1);
+		is_claimed.assign(n, 0);
+
+		for (auto* coordinates : { &x, &y, &z })
+		{
+			memory_placement::reserve(*coordinates, n);
+			coordinates->resize(n);
+		}
+
+		for (size_t k = 0; k < n; ++k)
+		{
+			const float* data = cloud.points[order[k]].data;
+			x[k] = data[0];
+			y[k] = data[1];
+			z[k] = data[2];
+		}
+
+		memory_placement::distribute(order);
+		memory_placement::distribute(leaf_of_point);
+
+		for (auto* coordinates : { &x, &y, &z })
+			memory_placement::distribute(*coordinates);
+
+		if (tree.root_node && n > 0)
+			mirror_node(tree.root_node, -1);
+	}
+
+	bool claimed(const point_index index) const
+	{
+		return is_claimed[index] != 0;
+	}
+
+	void claim(const point_index index)
+	{
+		if (is_claimed[index])
+			return;
+
+		is_claimed[index] = 1;
+
+		const int32_t leaf = leaf_of_point[index];
+
+		if (--remaining[leaf] > 0)
+			return;
+
+		for (int32_t node_index = parents[leaf]; node_index >= 0; node_index = parents[node_index])
+		{
+			if (--remaining[node_index] > 0) // node still has other child with unclaimed points
+				break;
+		}
+	}
+
+	/** @brief Finds unclaimed points whose squared distance to query is less than squared radius. Results (point index, squared distance)
+	 *	are sorted by distance.
+	*/
+	void radius_search(const float* query, const float squared_radius, std::vector<std::pair<point_index, float>>& results) const
+	{
+		results.clear();
+
+		if (!nodes.empty() && remaining[0] > 0)
+			search_node(0, query, squared_radius, results);
+
+		std::sort(results.begin(), results.end(), [](const std::pair<point_index, float>& a, const std::pair<point_index, float>& b)
+		{
+			return a.second < b.second || (a.second == b.second && a.first < b.first);
+		});
+	}
+
+	/** @brief Same as radius_search, with interface of radiusSearch of nanoflann. Returns number of found points.
+	*/
+	size_t radiusSearch(const float* query, const float squared_radius, std::vector<std::pair<point_index, float>>& results, const nanoflann::SearchParams& /* params */) const
+	{
+		radius_search(query, squared_radius, results);
+
+		return results.size();
+	}
+
+private:
+	struct node
+	{
+		float min[3], max[3]; // bounding box of points of subtree
+		size_t begin, end; // range of order
+		int32_t children[2]{ -1, -1 }; // leaf has no children
+	};
+
+	const point_cloud<float>& cloud;
+	const leaf_kernel::kernel scan;
+
+	std::vector<node> nodes; // nodes[0] is root
+	std::vector<int32_t> parents; // parent of every node (-1 for root)
+	std::vector<size_t> remaining; // unclaimed points of leaf or children with unclaimed points of inner node
+	std::vector<point_index> order; // indices to points of cloud ordered so every node covers continuous range
+	std::vector<int32_t> leaf_of_point;
+	std::vector<char> is_claimed;
+	std::vector<float> x, y, z; // coordinates of points in order of order
+
+	mutable std::vector<uint32_t> hits; // output of leaf kernel (large enough for largest leaf)
+	mutable std::vector<float> hit_distances;
+
+	template <typename Node>
+	int32_t mirror_node(const Node* tree_node, const int32_t parent)
+	{
+		const int32_t node_index = static_cast<int32_t>(nodes.size());
+		nodes.emplace_back();
+		parents.push_back(parent);
+		remaining.push_back(0);
+
+		node current;
+
+		if (!tree_node->child1 && !tree_node->child2) // leaf
+		{
+			current.begin = tree_node->node_type.lr.left;
+			current.end = tree_node->node_type.lr.right;
+			remaining[node_index] = current.end - current.begin;
+
+			if (hits.size() < current.end - current.begin)
+			{
+				hits.resize(current.end - current.begin);
+				hit_distances.resize(current.end - current.begin);
+			}
+
+			for (int d = 0; d < 3; ++d)
+				current.min[d] = current.max[d] = cloud.points[order[current.begin]].data[d];
+
+			for (size_t k = current.begin; k < current.end; ++k)
+			{
+				const float* data = cloud.points[order[k]].data;
+				leaf_of_point[order[k]] = node_index;
+
+				for (int d = 0; d < 3; ++d)
+				{
+					current.min[d] = std::min(current.min[d], data[d]);
+					current.max[d] = std::max(current.max[d], data[d]);
+				}
+			}
+		}
+		else
+		{
+			current.children[0] = mirror_node(tree_node->child1, node_index);
+			current.children[1] = mirror_node(tree_node->child2, node_index);
+
+			const node& first = nodes[current.children[0]];
+			const node& second = nodes[current.children[1]];
+
+			current.begin = std::min(first.begin, second.begin);
+			current.end = std::max(first.end, second.end);
+			remaining[node_index] = (remaining[current.children[0]] > 0) + (remaining[current.children[1]] > 0);
+
+			for (int d = 0; d < 3; ++d)
+			{
+				current.min[d] = std::min(first.min[d], second.min[d]);
+				current.max[d] = std::max(first.max[d], second.max[d]);
+			}
+		}
+
+		nodes[node_index] = current;
+
+		return node_index;
+	}
+
+	void search_node(const int32_t node_index, const float* query, const float squared_radius, std::vector<std::pair<point_index, float>>& results) const
+	{
+		const node& current = nodes[node_index];
+
+		float box_distance = 0;
+
+		for (int d = 0; d < 3; ++d)
+		{
+			const float outside = query[d] < current.min[d] ? current.min[d] - query[d] : (query[d] > current.max[d] ? query[d] - current.max[d] : 0);
+			box_distance += outside * outside;
+		}
+
+		if (box_distance >= squared_radius)
+			return;
+
+		if (current.children[0] < 0)
+		{
+			const size_t number_of_hits = scan(x.data() + current.begin, y.data() + current.begin, z.data() + current.begin, current.end - current.begin,
+				query, squared_radius, hits.data(), hit_distances.data());
+
+			for (size_t k = 0; k < number_of_hits; ++k)
+			{
+				const point_index index = order[current.begin + hits[k]];
+
+				if (!is_claimed[index])
+					results.emplace_back(index, hit_distances[k]);
+			}
+
+			return;
+		}
+
+		for (const int32_t child : current.children)
+		{
+			if (remaining[child] > 0)
+				search_node(child, query, squared_radius, results);
+		}
+	}
+};
+#endif // CLAIM_INDEX_HPP
@@ -0,0 +1,280 @@
+#ifndef CLOUD_CACHE_HPP
+#define CLOUD_CACHE_HPP
+#include "cancellation.hpp"
+#include "memory_mapped_file.hpp"
+#include "memory_placement.hpp"
+#include "point_cloud_reader.hpp"
+#include "progress.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+/** @brief Native binary cache of imported point cloud. Cache is written after first import of source file and is read instead of it
+ *	on later runs, as long as size and modification time of source file did not change.
+ *
+ *	File consists of fixed header followed by columnar blocks, each aligned to 64 bytes:
+ *	xyz coordinates (3 floats per point), normal vectors (3 floats per point, only if cloud has normals)
+ *	and colors (3 bytes per point, only if cloud has colors). Points may be stored in Morton (Z-order) order.
+*/
+namespace cloud_cache
+{
+	const char magic[8] = { 'P', 'C', 'O', 'C', 'A', 'C', 'H', 'E' };
+	const uint32_t version = 1;
+	const uint64_t block_alignment = 64;
+
+	enum flags : uint32_t { has_colors_flag = 1, has_normals_flag = 2, morton_order_flag = 4 };
+
+	struct header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t flags;
+		uint64_t number_of_points;
+		uint64_t source_size;
+		int64_t source_modification_time;
+		double origin[3];
+		uint64_t xyz_offset;
+		uint64_t normal_offset;
+		uint64_t color_offset;
+	};
+
+	/** @brief Size and modification time of source file; cache is valid only for source file with same stamp.
+	*/
+	inline bool source_stamp(const std::string& file_name, uint64_t& size, int64_t& modification_time)
+	{
+		struct stat file_status;
+
+		if (stat(file_name.c_str(), &file_status) != 0)
+			return false;
+
+		size = static_cast<uint64_t>(file_status.st_size);
+		modification_time = static_cast<int64_t>(file_status.st_mtime);
+
+		return true;
+	}
+
+	inline uint64_t aligned(const uint64_t offset)
+	{
+		return (offset + block_alignment - 1) / block_alignment * block_alignment;
+	}
+
+	/** @brief Spreads lower 21 bits of value so there are two zero bits between each of them.
+	*/
+	inline uint64_t spread_bits(uint64_t value)
+	{
+		value &= 0x1fffff;
+		value = (value | value << 32) & 0x1f00000000ffffULL;
+		value = (value | value << 16) & 0x1f0000ff0000ffULL;
+		value = (value | value << 8) & 0x100f00f00f00f00fULL;
+		value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+		value = (value | value << 2) & 0x1249249249249249ULL;
+
+		return value;
+	}
+
+	/** @brief Reorders points of cloud by Morton code of their coordinates quantized to 21 bits per axis inside bounding box.
+	 *	Points close in space become close in memory.
+	*/
+	inline void sort_by_morton_code(point_cloud<float>& cloud)
+	{
+		if (cloud.points.empty())
+			return;
+
+		if (!cloud.has_bounds)
+			cloud.compute_bounds();
+
+		const float* low = cloud.bounds_min;
+		const float* high = cloud.bounds_max;
+
+		const float extent = std::max(high[0] - low[0], std::max(high[1] - low[1], high[2] - low[2]));
+		const double scale = extent > 0 ? 0x1fffff / static_cast<double>(extent) : 0;
+
+		std::vector<std::pair<uint64_t, size_t>> codes(cloud.points.size());
+
+		for (size_t i = 0; i < cloud.points.size(); ++i)
+		{
+			uint64_t code = 0;
+
+			for (int j = 0; j < 3; ++j)
+				code |= spread_bits(static_cast<uint64_t>((cloud.points[i].data[j] - low[j]) * scale)) << j;
+
+			codes[i] = { code, i };
+		}
+
+		std::sort(codes.begin(), codes.end());
+
+		std::vector<point> sorted_points;
+		memory_placement::reserve(sorted_points, cloud.points.size());
+
+		for (const auto& code : codes)
+			sorted_points.push_back(cloud.points[code.second]);
+
+		cloud.points.swap(sorted_points);
+	}
+
+	/** @brief Writes point cloud to cache file. Source file name is used for stamp checked by is_valid.
+	*/
+	inline void write(const std::string& cache_file_name, const std::string& source_file_name, const point_cloud<float>& cloud, const bool morton_ordered)
+	{
+		header file_header{};
+		std::memcpy(file_header.magic, magic, sizeof(magic));
+		file_header.version = version;
+		file_header.flags = (cloud.has_colors ? has_colors_flag : 0) | (cloud.has_normals ? has_normals_flag : 0) | (morton_ordered ? morton_order_flag : 0);
+		file_header.number_of_points = cloud.points.size();
+
+		if (!source_stamp(source_file_name, file_header.source_size, file_header.source_modification_time))
+			throw std::runtime_error("Could not stat source file " + source_file_name);
+
+		std::copy(cloud.origin, cloud.origin + 3, file_header.origin);
+
+		const uint64_t n = cloud.points.size();
+		file_header.xyz_offset = aligned(sizeof(header));
+		file_header.normal_offset = aligned(file_header.xyz_offset + n * 3 * sizeof(float));
+		file_header.color_offset = cloud.has_normals ? aligned(file_header.normal_offset + n * 3 * sizeof(float)) : file_header.normal_offset;
+
+		std::ofstream output_file(cache_file_name, std::ios::binary | std::ios::trunc);
+
+		if (!output_file)
+			throw std::runtime_error("Could not create cache file " + cache_file_name);
+
+		// blocks are written in chunks to keep memory overhead small
+		const size_t chunk_size = 1 << 16;
+		std::vector<float> float_chunk;
+		std::vector<uint8_t> color_chunk;
+
+		auto pad_to = [&output_file](const uint64_t offset)
+		{
+			static const char zeros[block_alignment]{};
+			output_file.write(zeros, static_cast<std::streamsize>(offset - static_cast<uint64_t>(output_file.tellp())));
+		};
+
+		output_file.write(reinterpret_cast<const char*>(&file_header), sizeof(header));
+
+		for (int block = 0; block < 2; ++block) // xyz block and normal block
+		{
+			if (block == 1 && !cloud.has_normals)
+				break;
+
+			pad_to(block == 0 ? file_header.xyz_offset : file_header.normal_offset);
+
+			const int first_field = block == 0 ? 0 : 6;
+
+			for (size_t begin = 0; begin < n; begin += chunk_size)
+			{
+				const size_t end = std::min<size_t>(n, begin + chunk_size);
+				float_chunk.clear();
+
+				for (size_t i = begin; i < end; ++i)
+					float_chunk.insert(float_chunk.end(), cloud.points[i].data + first_field, cloud.points[i].data + first_field + 3);
+
+				output_file.write(reinterpret_cast<const char*>(float_chunk.data()), static_cast<std::streamsize>(float_chunk.size() * sizeof(float)));
+			}
+		}
+
+		if (cloud.has_colors)
+		{
+			pad_to(file_header.color_offset);
+
+			for (size_t begin = 0; begin < n; begin += chunk_size)
+			{
+				const size_t end = std::min<size_t>(n, begin + chunk_size);
+				color_chunk.clear();
+
+				for (size_t i = begin; i < end; ++i)
+				{
+					for (int j = 3; j < 6; ++j)
+						color_chunk.push_back(static_cast<uint8_t>(cloud.points[i].data[j]));
+				}
+
+				output_file.write(reinterpret_cast<const char*>(color_chunk.data()), static_cast<std::streamsize>(color_chunk.size()));
+			}
+		}
+
+		if (!output_file)
+			throw std::runtime_error("Could not write cache file " + cache_file_name);
+	}
+
+	/** @brief Decides whether cache file exists and was written from current version of source file with same point order.
+	*/
+	inline bool is_valid(const std::string& cache_file_name, const std::string& source_file_name, const bool morton_ordered)
+	{
+		std::ifstream cache_file(cache_file_name, std::ios::binary);
+		header file_header{};
+
+		if (!cache_file.read(reinterpret_cast<char*>(&file_header), sizeof(header)))
+			return false;
+
+		uint64_t source_size;
+		int64_t source_modification_time;
+
+		if (!source_stamp(source_file_name, source_size, source_modification_time))
+			return false;
+
+		return std::memcmp(file_header.magic, magic, sizeof(magic)) == 0 && file_header.version == version
+			&& file_header.source_size == source_size && file_header.source_modification_time == source_modification_time
+			&& ((file_header.flags & morton_order_flag) != 0) == morton_ordered;
+	}
+
+	/** @brief Reads points from memory-mapped cache file. No parsing is needed; columns are only interleaved into points.
+	*/
+	class reader : public point_cloud_reader
+	{
+	public:
+		void read(const std::string& file_name, point_cloud<float>& cloud) override
+		{
+			const memory_mapped_file file(file_name);
+
+			if (file.size() < sizeof(header))
+				throw std::runtime_error("Cache file is truncated");
+
+			header file_header;
+			std::memcpy(&file_header, file.data(), sizeof(header));
+
+			if (std::memcmp(file_header.magic, magic, sizeof(magic)) != 0 || file_header.version != version)
+				throw std::runtime_error("File is not point cloud cache");
+
+			const uint64_t n = file_header.number_of_points;
+			cloud.has_colors = (file_header.flags & has_colors_flag) != 0;
+			cloud.has_normals = (file_header.flags & has_normals_flag) != 0;
+			std::copy(file_header.origin, file_header.origin + 3, cloud.origin);
+
+			const uint64_t end_of_data = cloud.has_colors ? file_header.color_offset + n * 3 : file_header.normal_offset + (cloud.has_normals ? n * 3 * sizeof(float) : 0);
+
+			if (end_of_data > file.size())
+				throw std::runtime_error("Cache file is truncated");
+
+			const float* xyz = reinterpret_cast<const float*>(file.data() + file_header.xyz_offset);
+			const float* normals = reinterpret_cast<const float*>(file.data() + file_header.normal_offset);
+			const uint8_t* colors = file.data() + file_header.color_offset;
+
+			memory_placement::reserve(cloud.points, cloud.points.size() + n);
+			float values[9]{};
+
+			for (uint64_t i = 0; i < n; ++i)
+			{
+				std::copy(xyz + 3 * i, xyz + 3 * i + 3, values);
+
+				if (cloud.has_colors)
+					std::copy(colors + 3 * i, colors + 3 * i + 3, values + 3);
+
+				if (cloud.has_normals)
+					std::copy(normals + 3 * i, normals + 3 * i + 3, values + 6);
+
+				cloud.add_point(values);
+
+				if (i % 65536 == 0)
+				{
+					progress::shared_reporter().set(file.size() * i / n);
+					cancellation::shared_token().throw_if_cancelled();
+				}
+			}
+		}
+	};
+}
+#endif // CLOUD_CACHE_HPP
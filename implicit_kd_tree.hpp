@@ -0,0 +1,324 @@
+#ifndef IMPLICIT_KD_TREE_HPP
+#define IMPLICIT_KD_TREE_HPP
+#include "arena.hpp"
+#include "leaf_kernel.hpp"
+#include "memory_placement.hpp"
+#include "nanoflann.hpp"
+#include "parallel.hpp"
+#include "point_cloud.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/** @brief Pointer-free K-D tree over points of cloud with implicit breadth-first layout.
+ *	Tree is complete binary tree: children of node i are nodes 2i + 1 and 2i + 2 and all leaves are on last level,
+ *	so there are no child pointers and node holds only its split value (float) and split axis (1 byte).
+ *	Every node splits its points in halves by count (median along axis of largest extent), so range of points of leaf j
+ *	is computed from j and number of points and is not stored either. Points are referenced by point_index (32-bit by default).
+ *	Coordinates are copied in order of leaves as structure of arrays, so leaves are read sequentially and tested by SIMD leaf kernel.
+ *
+ *	Searches have same interface and results as searches of nanoflann (radiusSearch, knnSearch, findNeighbors),
+ *	so index can be used instead of nanoflann tree in cluster initialization.
+*/
+class implicit_kd_tree
+{
+public:
+	explicit implicit_kd_tree(const point_cloud<float>& source_cloud, const size_t max_leaf_points = 50)
+		: cloud(source_cloud), leaf_points(std::max<size_t>(1, max_leaf_points)), scan(leaf_kernel::active().scan)
+	{
+	}
+
+	/** @brief Builds tree over all points of cloud. Nodes of one level are split in parallel.
+	*/
+	void build()
+	{
+		const size_t n = cloud.points.size();
+
+		if (n > std::numeric_limits<point_index>::max())
+			throw std::length_error("too many points for point_index (build with POCO_INDEX_64)");
+
+		depth = 0;
+
+		while ((n >> depth) > leaf_points) // leaves of last level have at most leaf_points points
+			depth++;
+
+		// points are partitioned as compact entries, so nth_element moves 16 bytes instead of chasing indices to cloud
+		std::vector<entry> entries(n);
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			for (int d = 0; d < 3; ++d)
+				entries[i].coordinates[d] = cloud.points[i].data[d];
+
+			entries[i].index = static_cast<point_index>(i);
+		}
+
+		number_of_points = n;
+
+		const size_t number_of_inner_nodes = (size_t(1) << depth) - 1;
+		splits.assign(number_of_inner_nodes, 0);
+		axes.assign(number_of_inner_nodes, 0);
+
+		for (size_t level = 0; level < depth; ++level)
+		{
+			const size_t level_begin = (size_t(1) << level) - 1;
+
+			parallel::for_each_chunk(level_begin, 2 * level_begin + 1, 1, [&](const size_t begin, const size_t end)
+			{
+				for (size_t node = begin; node < end; ++node)
+					split_node(entries, node, level);
+			});
+		}
+
+		memory_placement::reserve(order, n);
+		order.resize(n);
+
+		for (auto* coordinates : { &x, &y, &z })
+		{
+			memory_placement::reserve(*coordinates, n);
+			coordinates->resize(n);
+		}
+
+		for (size_t k = 0; k < n; ++k)
+		{
+			order[k] = entries[k].index;
+			x[k] = entries[k].coordinates[0];
+			y[k] = entries[k].coordinates[1];
+			z[k] = entries[k].coordinates[2];
+		}
+
+		memory_placement::distribute(order);
+
+		for (auto* coordinates : { &x, &y, &z })
+			memory_placement::distribute(*coordinates);
+
+		for (int d = 0; d < 3; ++d) // bounding box tracked during import saves pass over coordinates
+		{
+			const std::vector<float>& coordinates = d == 0 ? x : (d == 1 ? y : z);
+			root_min[d] = cloud.has_bounds ? cloud.bounds_min[d] : (n > 0 ? *std::min_element(coordinates.begin(), coordinates.end()) : 0);
+			root_max[d] = cloud.has_bounds ? cloud.bounds_max[d] : (n > 0 ? *std::max_element(coordinates.begin(), coordinates.end()) : 0);
+		}
+	}
+
+	/** @brief Bytes of memory held by index (nodes, point indices and coordinates).
+	*/
+	size_t memory_bytes() const
+	{
+		return splits.capacity() * sizeof(float) + axes.capacity() + order.capacity() * sizeof(point_index) + (x.capacity() + y.capacity() + z.capacity()) * sizeof(float);
+	}
+
+	/** @brief Passes every point closer to query than worst distance of result set to result set (same as findNeighbors of nanoflann).
+	 *	Closer child of every node is visited first.
+	*/
+	template <typename ResultSet>
+	bool findNeighbors(ResultSet& result, const float* query, const nanoflann::SearchParams& /* params */) const
+	{
+		if (order.empty())
+			return true;
+
+		float min[3] = { root_min[0], root_min[1], root_min[2] };
+		float max[3] = { root_max[0], root_max[1], root_max[2] };
+
+		return search_node(0, 0, min, max, query, result);
+	}
+
+	/** @brief Finds points whose squared distance to query is less than squared radius. Results (point index, squared distance)
+	 *	are sorted by distance. Returns number of found points.
+	*/
+	size_t radiusSearch(const float* query, const float squared_radius, std::vector<std::pair<point_index, float>>& results, const nanoflann::SearchParams& /* params */) const
+	{
+		results.clear();
+
+		if (!order.empty())
+		{
+			float min[3] = { root_min[0], root_min[1], root_min[2] };
+			float max[3] = { root_max[0], root_max[1], root_max[2] };
+
+			arena::scope search_memory; // output of leaf kernel is allocated in arena of calling thread, so concurrent searches do not share it
+			arena::vector<uint32_t> hits(leaf_points + 1);
+			arena::vector<float> hit_distances(leaf_points + 1);
+
+			radius_node(0, 0, min, max, query, squared_radius, hits, hit_distances, results);
+		}
+
+		std::sort(results.begin(), results.end(), [](const std::pair<point_index, float>& a, const std::pair<point_index, float>& b)
+		{
+			return a.second < b.second || (a.second == b.second && a.first < b.first);
+		});
+
+		return results.size();
+	}
+
+	/** @brief Finds k nearest neighbours of query (same as knnSearch of nanoflann). Returns number of found points.
+	*/
+	size_t knnSearch(const float* query, const size_t k, point_index* indices, float* distances) const
+	{
+		nanoflann::KNNResultSet<float, point_index> result(k);
+		result.init(indices, distances);
+		findNeighbors(result, query, nanoflann::SearchParams());
+
+		return result.size();
+	}
+
+private:
+	const point_cloud<float>& cloud;
+	const size_t leaf_points;
+	const leaf_kernel::kernel scan;
+
+	struct entry
+	{
+		float coordinates[3];
+		point_index index;
+	};
+
+	size_t number_of_points = 0;
+	size_t depth = 0; // leaves are on this level (root is on level 0)
+	std::vector<float> splits; // split value of inner node; points of left child are not greater and points of right child not less than it
+	std::vector<uint8_t> axes; // split axis of inner node
+	std::vector<point_index> order; // indices to points of cloud in order of leaves
+	std::vector<float> x, y, z; // coordinates of points in order of order
+	float root_min[3]{}, root_max[3]{};
+
+	/** @brief First position in order of points of leaf with given number (number of leaves is 2^depth).
+	*/
+	size_t leaf_begin(const size_t leaf) const
+	{
+		return static_cast<size_t>((static_cast<uint64_t>(leaf) * number_of_points) >> depth);
+	}
+
+	/** @brief Range of positions in order of points of node on given level.
+	*/
+	std::pair<size_t, size_t> node_range(const size_t node, const size_t level) const
+	{
+		const size_t first_leaf = (node + 1 - (size_t(1) << level)) << (depth - level);
+
+		return { leaf_begin(first_leaf), leaf_begin(first_leaf + (size_t(1) << (depth - level))) };
+	}
+
+	void split_node(std::vector<entry>& entries, const size_t node, const size_t level)
+	{
+		const std::pair<size_t, size_t> range = node_range(node, level);
+		const size_t middle = node_range(2 * node + 2, level + 1).first; // first point of right child
+
+		float min[3], max[3];
+
+		for (int d = 0; d < 3; ++d)
+		{
+			min[d] = std::numeric_limits<float>::max();
+			max[d] = std::numeric_limits<float>::lowest();
+		}
+
+		for (size_t k = range.first; k < range.second; ++k)
+		{
+			for (int d = 0; d < 3; ++d)
+			{
+				min[d] = std::min(min[d], entries[k].coordinates[d]);
+				max[d] = std::max(max[d], entries[k].coordinates[d]);
+			}
+		}
+
+		const int axis = max[0] - min[0] >= max[1] - min[1] && max[0] - min[0] >= max[2] - min[2] ? 0 : (max[1] - min[1] >= max[2] - min[2] ? 1 : 2);
+
+		axes[node] = static_cast<uint8_t>(axis);
+
+		if (range.first == range.second)
+			return;
+
+		std::nth_element(entries.begin() + range.first, entries.begin() + middle, entries.begin() + range.second, [axis](const entry& a, const entry& b)
+		{
+			return a.coordinates[axis] < b.coordinates[axis];
+		});
+
+		splits[node] = middle < range.second ? entries[middle].coordinates[axis] : max[axis];
+	}
+
+	static float box_distance(const float* query, const float min[3], const float max[3])
+	{
+		float distance = 0;
+
+		for (int d = 0; d < 3; ++d)
+		{
+			const float outside = query[d] < min[d] ? min[d] - query[d] : (query[d] > max[d] ? query[d] - max[d] : 0);
+			distance += outside * outside;
+		}
+
+		return distance;
+	}
+
+	template <typename ResultSet>
+	bool search_node(const size_t node, const size_t level, float min[3], float max[3], const float* query, ResultSet& result) const
+	{
+		if (level == depth)
+		{
+			const std::pair<size_t, size_t> range = node_range(node, level);
+
+			for (size_t k = range.first; k < range.second; ++k)
+			{
+				const float dx = query[0] - x[k], dy = query[1] - y[k], dz = query[2] - z[k];
+				const float distance = dx * dx + dy * dy + dz * dz; // same order of operations as L2_Simple_Adaptor of nanoflann
+
+				if (distance < result.worstDist() && !result.addPoint(distance, order[k]))
+					return false;
+			}
+
+			return true;
+		}
+
+		const int axis = axes[node];
+		const float split = splits[node];
+		const bool left_first = query[axis] < split;
+
+		for (int side = 0; side < 2; ++side)
+		{
+			const bool left = (side == 0) == left_first;
+			float& bound = left ? max[axis] : min[axis];
+			const float saved_bound = bound;
+			bound = split; // bounding box of child
+
+			const bool proceed = box_distance(query, min, max) >= result.worstDist() || search_node(left ? 2 * node + 1 : 2 * node + 2, level + 1, min, max, query, result);
+
+			bound = saved_bound;
+
+			if (!proceed)
+				return false;
+		}
+
+		return true;
+	}
+
+	void radius_node(const size_t node, const size_t level, float min[3], float max[3], const float* query, const float squared_radius,
+		arena::vector<uint32_t>& hits, arena::vector<float>& hit_distances, std::vector<std::pair<point_index, float>>& results) const
+	{
+		if (box_distance(query, min, max) >= squared_radius)
+			return;
+
+		if (level == depth)
+		{
+			const std::pair<size_t, size_t> range = node_range(node, level);
+			const size_t number_of_hits = scan(x.data() + range.first, y.data() + range.first, z.data() + range.first, range.second - range.first,
+				query, squared_radius, hits.data(), hit_distances.data());
+
+			for (size_t k = 0; k < number_of_hits; ++k)
+				results.emplace_back(order[range.first + hits[k]], hit_distances[k]);
+
+			return;
+		}
+
+		const int axis = axes[node];
+		const float split = splits[node];
+
+		const float saved_max = max[axis];
+		max[axis] = split;
+		radius_node(2 * node + 1, level + 1, min, max, query, squared_radius, hits, hit_distances, results);
+		max[axis] = saved_max;
+
+		const float saved_min = min[axis];
+		min[axis] = split;
+		radius_node(2 * node + 2, level + 1, min, max, query, squared_radius, hits, hit_distances, results);
+		min[axis] = saved_min;
+	}
+};
+#endif // IMPLICIT_KD_TREE_HPP
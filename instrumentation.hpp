@@ -0,0 +1,261 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+/** @brief Per-stage measurements of optimization run (wall and CPU time, peak memory, amount of processed data)
+ *	and their export to machine-readable JSON report.
+*/
+namespace instrumentation
+{
+	/** @brief CPU time (user + system) consumed by all threads of this process so far.
+	*/
+	inline double process_cpu_seconds()
+	{
+#ifdef _WIN32
+		FILETIME creation_time, exit_time, kernel_time, user_time;
+
+		if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+			return 0;
+
+		auto to_seconds = [](const FILETIME& time) { return ((static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7; };
+
+		return to_seconds(kernel_time) + to_seconds(user_time);
+#else
+		rusage usage;
+
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+
+		return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+	}
+
+	/** @brief Peak resident set size (peak working set on Windows) of this process in bytes.
+	*/
+	inline size_t peak_rss_bytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage;
+
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+
+#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss); // bytes on macOS
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024; // kilobytes on Linux
+#endif
+#endif
+	}
+
+	/** @brief Counter of heap allocations (calls of global operator new) of this process. Only replacement of global operator new
+	 *	in allocation_counter.cpp increments it; that file is linked into executables only (CMake option POCO_COUNT_ALLOCATIONS),
+	 *	so other programs linking optimizer library keep their own allocator.
+	*/
+	inline std::atomic<size_t>& allocations()
+	{
+		static std::atomic<size_t> counter(0); // constant-initialized, so it is ready for allocations of static initialization
+		return counter;
+	}
+
+	/** @brief Set by allocation_counter.cpp if it is linked; otherwise allocations are reported as null.
+	*/
+	inline bool& counts_allocations()
+	{
+		static bool linked = false;
+		return linked;
+	}
+
+	inline size_t allocation_count()
+	{
+		return allocations().load(std::memory_order_relaxed);
+	}
+
+	/** @brief Allocation count as JSON value (null if allocations are not counted).
+	*/
+	inline std::string json_allocations(const size_t count)
+	{
+		return counts_allocations() ? std::to_string(count) : "null";
+	}
+
+	/** @brief Measurements of one stage of run.
+	*/
+	struct stage_record
+	{
+		std::string name;
+		double wall_seconds = 0;
+		double cpu_seconds = 0;
+		size_t peak_rss_bytes = 0; // peak of whole process at end of stage
+		size_t points = 0; // number of points processed by stage
+		size_t clusters = 0; // number of clusters produced or processed by stage
+		size_t allocations = 0; // heap allocations during stage
+	};
+
+	/** @brief Escapes string for JSON.
+	*/
+	inline std::string json_string(const std::string& text)
+	{
+		std::string escaped = "\"";
+
+		for (const char c : text)
+		{
+			switch (c)
+			{
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char code[7];
+					snprintf(code, sizeof(code), "\\u%04x", c);
+					escaped += code;
+				}
+				else
+					escaped += c;
+			}
+		}
+
+		return escaped + "\"";
+	}
+
+	/** @brief Report of whole run. Stages are recorded in order of their execution.
+	 *	Settings and summary values are kept as already formatted JSON values, so report does not depend on their types.
+	*/
+	class run_report
+	{
+	public:
+		std::vector<stage_record> stages;
+		std::vector<std::pair<std::string, std::string>> settings; // name and JSON value
+		std::vector<std::pair<std::string, std::string>> summary; // name and JSON value
+
+		void set_setting(const std::string& name, const std::string& json_value)
+		{
+			set(settings, name, json_value);
+		}
+
+		void set_summary(const std::string& name, const std::string& json_value)
+		{
+			set(summary, name, json_value);
+		}
+
+		/** @brief Writes report as JSON object with "settings", "stages" and "summary" members.
+		*/
+		void write_json(const std::string& file_name) const
+		{
+			std::ofstream output_file(file_name);
+
+			if (!output_file)
+				throw std::runtime_error("Could not create report file " + file_name);
+
+			output_file << std::setprecision(9);
+			output_file << "{\n  \"settings\": {";
+			write_members(output_file, settings);
+			output_file << " },\n  \"stages\": [";
+
+			double total_wall_seconds = 0;
+
+			for (size_t i = 0; i < stages.size(); ++i)
+			{
+				const stage_record& stage = stages[i];
+				total_wall_seconds += stage.wall_seconds;
+
+				output_file << (i ? "," : "") << "\n    { \"name\": " << json_string(stage.name)
+					<< ", \"wall_seconds\": " << stage.wall_seconds << ", \"cpu_seconds\": " << stage.cpu_seconds
+					<< ", \"peak_rss_bytes\": " << stage.peak_rss_bytes << ", \"points\": " << stage.points << ", \"clusters\": " << stage.clusters
+					<< ", \"points_per_second\": " << (stage.wall_seconds > 0 ? stage.points / stage.wall_seconds : 0) << ", \"allocations\": " << json_allocations(stage.allocations) << " }";
+			}
+
+			output_file << "\n  ],\n  \"summary\": {";
+			write_members(output_file, summary);
+			output_file << (summary.empty() ? "" : ",") << " \"total_wall_seconds\": " << total_wall_seconds
+				<< ", \"peak_rss_bytes\": " << peak_rss_bytes() << ", \"allocations\": " << json_allocations(allocation_count()) << " }\n}\n";
+
+			if (!output_file)
+				throw std::runtime_error("Could not write report file " + file_name);
+		}
+
+	private:
+		static void set(std::vector<std::pair<std::string, std::string>>& members, const std::string& name, const std::string& json_value)
+		{
+			for (auto& member : members)
+			{
+				if (member.first == name)
+				{
+					member.second = json_value;
+					return;
+				}
+			}
+
+			members.emplace_back(name, json_value);
+		}
+
+		static void write_members(std::ostream& output, const std::vector<std::pair<std::string, std::string>>& members)
+		{
+			for (size_t i = 0; i < members.size(); ++i)
+				output << (i ? ", " : " ") << json_string(members[i].first) << ": " << members[i].second;
+		}
+	};
+
+	/** @brief Measures one stage from construction until stop() and appends its record to report.
+	*/
+	class stage_timer
+	{
+	public:
+		stage_timer(run_report& run, const std::string& stage_name)
+			: report(run), start_wall(std::chrono::steady_clock::now()), start_cpu(process_cpu_seconds()), start_allocations(allocation_count())
+		{
+			record.name = stage_name;
+		}
+
+		void stop(const size_t points, const size_t clusters = 0)
+		{
+			record.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_wall).count();
+			record.cpu_seconds = process_cpu_seconds() - start_cpu;
+			record.peak_rss_bytes = peak_rss_bytes();
+			record.points = points;
+			record.clusters = clusters;
+			record.allocations = allocation_count() - start_allocations;
+
+			report.stages.push_back(record);
+		}
+
+	private:
+		run_report& report;
+		stage_record record;
+		std::chrono::steady_clock::time_point start_wall;
+		double start_cpu;
+		size_t start_allocations;
+	};
+}
+#endif // INSTRUMENTATION_HPP
@@ -0,0 +1,146 @@
+#ifndef LAS_READER_HPP
+#define LAS_READER_HPP
+#include "cancellation.hpp"
+#include "memory_mapped_file.hpp"
+#include "memory_placement.hpp"
+#include "point_cloud_reader.hpp"
+#include "progress.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+/** @brief Reads uncompressed ASPRS LAS 1.2 - 1.4 files directly from memory map.
+ *	Point data record formats 0 - 10 are accepted; colors are read from formats which carry them (2, 3, 5, 7, 8 and 10).
+ *	LAS does not store normal vectors, so has_normals of point cloud is always cleared.
+ *
+ *	Integer coordinates are scaled and offset as described in header and then shifted by origin of point cloud
+ *	(minimum of bounding box from header), so they keep their precision in float.
+*/
+class las_reader : public point_cloud_reader
+{
+public:
+	void read(const std::string& file_name, point_cloud<float>& cloud) override
+	{
+		const memory_mapped_file file(file_name);
+		const unsigned char* data = file.data();
+
+		if (file.size() < legacy_header_size || std::memcmp(data, "LASF", 4) != 0)
+			throw std::runtime_error("File is not LAS file");
+
+		const int version_major = data[24];
+		const int version_minor = data[25];
+
+		if (version_major != 1 || version_minor < 2 || version_minor > 4)
+			throw std::runtime_error("Unsupported LAS version " + std::to_string(version_major) + "." + std::to_string(version_minor));
+
+		const uint16_t header_size = read_value<uint16_t>(data + 94);
+		const uint32_t offset_to_points = read_value<uint32_t>(data + 96);
+		const uint8_t point_format = data[104];
+		const uint16_t record_length = read_value<uint16_t>(data + 105);
+
+		if (point_format & 0xC0) // bits 6 and 7 are set by LASzip for compressed files
+			throw std::runtime_error("Compressed LAZ files are not supported");
+
+		if (point_format > 10 || record_length < record_length_for_format(point_format))
+			throw std::runtime_error("Unsupported LAS point data record format " + std::to_string(point_format));
+
+		uint64_t number_of_points = read_value<uint32_t>(data + 107);
+
+		if (version_minor == 4 && header_size >= 375 && number_of_points == 0) // LAS 1.4 keeps 64-bit count; legacy count is 0 for large files
+			number_of_points = read_value<uint64_t>(data + 247);
+
+		if (offset_to_points + number_of_points * record_length > file.size())
+			throw std::runtime_error("LAS file is truncated");
+
+		double scale[3], offset[3];
+
+		for (int i = 0; i < 3; ++i)
+		{
+			scale[i] = read_value<double>(data + 131 + 8 * i);
+			offset[i] = read_value<double>(data + 155 + 8 * i);
+			cloud.origin[i] = std::floor(read_value<double>(data + 187 + 16 * i)); // header stores max and min for each axis
+		}
+
+		const int color_offset = color_offset_for_format(point_format);
+
+		cloud.has_colors = color_offset >= 0;
+		cloud.has_normals = false;
+
+		const size_t first_new_point = cloud.points.size();
+		memory_placement::reserve(cloud.points, first_new_point + number_of_points);
+
+		uint16_t max_color = 0;
+		float values[9]{};
+		const unsigned char* record = data + offset_to_points;
+
+		for (uint64_t i = 0; i < number_of_points; ++i, record += record_length)
+		{
+			for (int j = 0; j < 3; ++j)
+				values[j] = static_cast<float>(read_value<int32_t>(record + 4 * j) * scale[j] + offset[j] - cloud.origin[j]);
+
+			if (color_offset >= 0)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					const uint16_t color = read_value<uint16_t>(record + color_offset + 2 * j);
+					values[3 + j] = color;
+
+					if (color > max_color)
+						max_color = color;
+				}
+			}
+
+			cloud.add_point(values);
+
+			if (i % 65536 == 0)
+			{
+				progress::shared_reporter().set(offset_to_points + i * record_length);
+				cancellation::shared_token().throw_if_cancelled();
+			}
+		}
+
+		// LAS specification asks for 16-bit colors, but many writers store 8-bit values; 16-bit colors are scaled to integers in range of .ply uchar
+		// (colors must stay integral, otherwise exported .ply file and cache, which stores colors as bytes, would not hold same values)
+		if (max_color > 255)
+		{
+			for (size_t i = first_new_point; i < cloud.points.size(); ++i)
+			{
+				for (int j = 3; j < 6; ++j)
+					cloud.points[i].data[j] = std::min(255.0f, std::round(cloud.points[i].data[j] / 257.0f));
+			}
+		}
+	}
+
+private:
+	static const size_t legacy_header_size = 227;
+
+	/** @brief Byte offset of red channel inside point data record of given format (-1 for formats without colors).
+	*/
+	static int color_offset_for_format(const uint8_t point_format)
+	{
+		static const int offsets[11] = { -1, -1, 20, 28, -1, 28, -1, 30, 30, -1, 30 };
+		return offsets[point_format];
+	}
+
+	/** @brief Size of point data record of given format without extra bytes.
+	*/
+	static uint16_t record_length_for_format(const uint8_t point_format)
+	{
+		static const uint16_t lengths[11] = { 20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67 };
+		return lengths[point_format];
+	}
+
+	/** @brief Reads little-endian value from unaligned position in file.
+	*/
+	template <typename T>
+	static T read_value(const unsigned char* position)
+	{
+		T value;
+		std::memcpy(&value, position, sizeof(T));
+		return value;
+	}
+};
+#endif // LAS_READER_HPP
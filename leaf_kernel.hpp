@@ -0,0 +1,183 @@
+#ifndef LEAF_KERNEL_HPP
+#define LEAF_KERNEL_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LEAF_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LEAF_KERNEL_TARGET(instruction_set) // MSVC compiles intrinsics of any instruction set without special flags
+#else
+#define LEAF_KERNEL_TARGET(instruction_set) __attribute__((target(instruction_set)))
+#endif
+#endif
+
+/** @brief Test of whole K-D tree leaf against radius of query. Coordinates of leaf are stored as structure of arrays (x, y and z of consecutive points),
+ *	so AVX2 kernel tests 8 and AVX-512 kernel 16 points at once. Kernel builds mask of points inside radius and appends their offsets
+ *	and squared distances to output arrays in bulk (compress store with AVX-512).
+ *	Squared distance is sum of squared differences in order x, y, z without fused multiply-add, same as L2_Simple_Adaptor of nanoflann,
+ *	so all kernels find exactly same points as nanoflann. Kernel is selected at run time by instruction sets supported by processor.
+*/
+namespace leaf_kernel
+{
+	/** @brief Kernel signature: tests count points against squared radius and writes offsets (0 to count - 1) of points with
+	 *	squared distance less than squared radius to hits and their squared distances to distances, in order of points. Returns number of hits.
+	 *	Output arrays must have space for count elements.
+	*/
+	typedef size_t(*kernel)(const float* x, const float* y, const float* z, size_t count, const float* query, float squared_radius, uint32_t* hits, float* distances);
+
+	inline size_t scan_scalar(const float* x, const float* y, const float* z, const size_t count, const float* query, const float squared_radius, uint32_t* hits, float* distances)
+	{
+		size_t number_of_hits = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float dx = query[0] - x[i], dy = query[1] - y[i], dz = query[2] - z[i];
+			const float distance = dx * dx + dy * dy + dz * dz;
+
+			if (distance < squared_radius)
+			{
+				hits[number_of_hits] = static_cast<uint32_t>(i);
+				distances[number_of_hits++] = distance;
+			}
+		}
+
+		return number_of_hits;
+	}
+
+#ifdef LEAF_KERNEL_X86
+	LEAF_KERNEL_TARGET("avx2,bmi")
+	inline size_t scan_avx2(const float* x, const float* y, const float* z, const size_t count, const float* query, const float squared_radius, uint32_t* hits, float* distances)
+	{
+		const __m256 qx = _mm256_set1_ps(query[0]), qy = _mm256_set1_ps(query[1]), qz = _mm256_set1_ps(query[2]);
+		const __m256 radius = _mm256_set1_ps(squared_radius);
+
+		size_t number_of_hits = 0;
+		size_t i = 0;
+
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 dx = _mm256_sub_ps(qx, _mm256_loadu_ps(x + i));
+			const __m256 dy = _mm256_sub_ps(qy, _mm256_loadu_ps(y + i));
+			const __m256 dz = _mm256_sub_ps(qz, _mm256_loadu_ps(z + i));
+			const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(distance, radius, _CMP_LT_OQ)));
+
+			if (mask == 0)
+				continue;
+
+			alignas(32) float lane_distances[8];
+			_mm256_store_ps(lane_distances, distance);
+
+			for (; mask != 0; mask &= mask - 1) // lowest set bit first, so hits keep order of points
+			{
+				const unsigned lane = static_cast<unsigned>(_tzcnt_u32(mask));
+				hits[number_of_hits] = static_cast<uint32_t>(i + lane);
+				distances[number_of_hits++] = lane_distances[lane];
+			}
+		}
+
+		const size_t tail_hits = scan_scalar(x + i, y + i, z + i, count - i, query, squared_radius, hits + number_of_hits, distances + number_of_hits);
+
+		for (size_t k = number_of_hits; k < number_of_hits + tail_hits; ++k)
+			hits[k] += static_cast<uint32_t>(i);
+
+		return number_of_hits + tail_hits;
+	}
+
+	LEAF_KERNEL_TARGET("avx512f,popcnt")
+	inline size_t scan_avx512(const float* x, const float* y, const float* z, const size_t count, const float* query, const float squared_radius, uint32_t* hits, float* distances)
+	{
+		const __m512 qx = _mm512_set1_ps(query[0]), qy = _mm512_set1_ps(query[1]), qz = _mm512_set1_ps(query[2]);
+		const __m512 radius = _mm512_set1_ps(squared_radius);
+		const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+		size_t number_of_hits = 0;
+
+		for (size_t i = 0; i < count; i += 16)
+		{
+			const __mmask16 valid = count - i >= 16 ? static_cast<__mmask16>(0xffff) : static_cast<__mmask16>((1u << (count - i)) - 1); // last block may be partial
+
+			const __m512 dx = _mm512_sub_ps(qx, _mm512_maskz_loadu_ps(valid, x + i));
+			const __m512 dy = _mm512_sub_ps(qy, _mm512_maskz_loadu_ps(valid, y + i));
+			const __m512 dz = _mm512_sub_ps(qz, _mm512_maskz_loadu_ps(valid, z + i));
+			const __m512 distance = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+
+			const __mmask16 mask = _mm512_mask_cmp_ps_mask(valid, distance, radius, _CMP_LT_OQ);
+
+			if (mask == 0)
+				continue;
+
+			_mm512_mask_compressstoreu_epi32(hits + number_of_hits, mask, _mm512_add_epi32(lanes, _mm512_set1_epi32(static_cast<int>(i))));
+			_mm512_mask_compressstoreu_ps(distances + number_of_hits, mask, distance);
+			number_of_hits += static_cast<size_t>(_mm_popcnt_u32(mask));
+		}
+
+		return number_of_hits;
+	}
+#endif
+
+	struct selection
+	{
+		kernel scan;
+		std::string name;
+	};
+
+	/** @brief Returns kernel with given name ("scalar", "avx2" or "avx512") if processor supports it, otherwise best supported kernel.
+	*/
+	inline selection select(const std::string& requested = "")
+	{
+		selection scalar{ scan_scalar, "scalar" };
+
+#ifdef LEAF_KERNEL_X86
+#ifdef _MSC_VER
+		int registers[4];
+		__cpuid(registers, 0);
+		const int max_leaf = registers[0];
+
+		__cpuid(registers, 1);
+		const bool has_os_avx = (registers[2] & (1 << 27)) != 0 && (registers[2] & (1 << 28)) != 0; // OSXSAVE and AVX
+		const bool has_popcnt = (registers[2] & (1 << 23)) != 0;
+		const unsigned long long enabled_state = has_os_avx ? _xgetbv(0) : 0;
+
+		bool has_avx2 = false, has_avx512 = false;
+
+		if (max_leaf >= 7 && (enabled_state & 0x6) == 0x6) // XMM and YMM state is saved by operating system
+		{
+			__cpuidex(registers, 7, 0);
+			has_avx2 = (registers[1] & (1 << 5)) != 0 && (registers[1] & (1 << 3)) != 0; // AVX2 and BMI1 (tzcnt)
+			has_avx512 = (registers[1] & (1 << 16)) != 0 && (enabled_state & 0xe6) == 0xe6 && has_popcnt; // AVX-512F and opmask and ZMM state
+		}
+#else
+		// every instruction set of target attribute of kernel is required, so virtual machines hiding some of them do not get illegal instruction
+		__builtin_cpu_init();
+		const bool has_avx2 = __builtin_cpu_supports("avx2") != 0 && __builtin_cpu_supports("bmi") != 0;
+		const bool has_avx512 = __builtin_cpu_supports("avx512f") != 0 && __builtin_cpu_supports("popcnt") != 0;
+#endif
+
+		if (requested == "scalar")
+			return scalar;
+
+		if (has_avx512 && (requested.empty() || requested == "avx512"))
+			return { scan_avx512, "avx512" };
+
+		if (has_avx2)
+			return { scan_avx2, "avx2" };
+#endif
+
+		return scalar;
+	}
+
+	/** @brief Kernel used by searches of this process (best supported one by default).
+	*/
+	inline selection& active()
+	{
+		static selection instance = select();
+		return instance;
+	}
+}
+#endif // LEAF_KERNEL_HPP
@@ -0,0 +1,127 @@
+#ifndef MEMORY_MAPPED_FILE_HPP
+#define MEMORY_MAPPED_FILE_HPP
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** @brief Read-only memory map of whole file. File is mapped in constructor and unmapped in destructor.
+ *	Pages are hinted to be read sequentially, so kernel can read ahead while points are being decoded.
+*/
+class memory_mapped_file
+{
+public:
+	explicit memory_mapped_file(const std::string& file_name)
+	{
+#ifdef _WIN32
+		file_handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+		if (file_handle == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Could not open file " + file_name);
+
+		LARGE_INTEGER file_size;
+		GetFileSizeEx(file_handle, &file_size);
+		mapped_size = static_cast<size_t>(file_size.QuadPart);
+
+		if (mapped_size == 0)
+			return;
+
+		mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (!mapping_handle)
+		{
+			CloseHandle(file_handle);
+			throw std::runtime_error("Could not map file " + file_name);
+		}
+
+		mapped_data = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+
+		if (!mapped_data)
+		{
+			CloseHandle(mapping_handle);
+			CloseHandle(file_handle);
+			throw std::runtime_error("Could not map file " + file_name);
+		}
+#else
+		const int file_descriptor = open(file_name.c_str(), O_RDONLY);
+
+		if (file_descriptor < 0)
+			throw std::runtime_error("Could not open file " + file_name);
+
+		struct stat file_status;
+
+		if (fstat(file_descriptor, &file_status) != 0)
+		{
+			close(file_descriptor);
+			throw std::runtime_error("Could not open file " + file_name);
+		}
+
+		mapped_size = static_cast<size_t>(file_status.st_size);
+
+		if (mapped_size == 0)
+		{
+			close(file_descriptor);
+			return;
+		}
+
+		void* address = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+		close(file_descriptor); // mapping stays valid after descriptor is closed
+
+		if (address == MAP_FAILED)
+			throw std::runtime_error("Could not map file " + file_name);
+
+		madvise(address, mapped_size, MADV_SEQUENTIAL);
+		mapped_data = static_cast<const unsigned char*>(address);
+#endif
+	}
+
+	~memory_mapped_file()
+	{
+#ifdef _WIN32
+		if (mapped_data)
+			UnmapViewOfFile(mapped_data);
+
+		if (mapping_handle)
+			CloseHandle(mapping_handle);
+
+		CloseHandle(file_handle);
+#else
+		if (mapped_data)
+			munmap(const_cast<unsigned char*>(mapped_data), mapped_size);
+#endif
+	}
+
+	memory_mapped_file(const memory_mapped_file&) = delete;
+	memory_mapped_file& operator=(const memory_mapped_file&) = delete;
+
+	const unsigned char* data() const
+	{
+		return mapped_data;
+	}
+
+	size_t size() const
+	{
+		return mapped_size;
+	}
+
+private:
+	const unsigned char* mapped_data = nullptr;
+	size_t mapped_size = 0;
+
+#ifdef _WIN32
+	HANDLE file_handle = INVALID_HANDLE_VALUE;
+	HANDLE mapping_handle = nullptr;
+#endif
+};
+#endif // MEMORY_MAPPED_FILE_HPP
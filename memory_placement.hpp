@@ -0,0 +1,215 @@
+#ifndef MEMORY_PLACEMENT_HPP
+#define MEMORY_PLACEMENT_HPP
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/** @brief Placement of large arrays (points of cloud, coordinates and indices of search indices) in physical memory.
+ *	Transparent huge pages (2 MB) map array by far fewer TLB entries, so random accesses of K-D tree searches miss TLB less often.
+ *	On machines with more NUMA nodes, pages are either interleaved over all nodes allowed for process, so all memory controllers serve searches evenly,
+ *	or moved in 2 MB chunks of parallel loop to nodes of worker threads (first touch), so pages are spread over nodes of threads which process points.
+ *	Huge pages and interleaving apply only to memory which was not written yet, so they are requested when memory is reserved (see reserve);
+ *	first touch applies to constructed elements, so it follows filling of array (see distribute).
+ *	Only Linux is supported, elsewhere settings have no effect.
+*/
+namespace memory_placement
+{
+	enum class numa_policy { none, interleave, first_touch };
+
+	struct settings
+	{
+		bool huge_pages = false;
+		numa_policy numa = numa_policy::none;
+	};
+
+	/** @brief Settings used for arrays of this process (system defaults by default).
+	*/
+	inline settings& active()
+	{
+		static settings instance;
+		return instance;
+	}
+
+	inline std::string policy_name(const numa_policy policy)
+	{
+		return policy == numa_policy::interleave ? "interleave" : (policy == numa_policy::first_touch ? "first_touch" : "none");
+	}
+
+	/** @brief System error (errno) of first NUMA placement of this process which failed (0 if all placements succeeded).
+	*/
+	inline std::atomic<int>& numa_error()
+	{
+		static std::atomic<int> error(0);
+		return error;
+	}
+
+	/** @brief Outcome of NUMA placement for run report: name of active policy, or "not applied" with error if any placement failed.
+	*/
+	inline std::string numa_status()
+	{
+		const int error = numa_error().load();
+
+		if (error == 0)
+			return policy_name(active().numa);
+
+		return "not applied (" + policy_name(active().numa) + ": errno " + std::to_string(error) + ", " + std::strerror(error) + ")";
+	}
+
+#ifdef __linux__
+	// from numaif.h (libnuma is not needed for few system calls)
+	const int mpol_interleave = 3;
+	const int mpol_local = 4;
+	const unsigned mpol_mf_move = 1 << 1;
+	const unsigned long mpol_f_mems_allowed = 1 << 2;
+
+	inline void record_numa_error(const int error)
+	{
+		int expected = 0;
+		numa_error().compare_exchange_strong(expected, error);
+	}
+
+	/** @brief Mask of NUMA nodes on which process may allocate memory (cpuset and online nodes), as returned by get_mempolicy.
+	 *	Kernel rejects masks shorter than its number of possible nodes, so mask grows until it is accepted. Empty if it is not known (error is recorded).
+	*/
+	inline const std::vector<unsigned long>& allowed_nodes()
+	{
+		static const std::vector<unsigned long> mask = []
+		{
+			const size_t word_bits = 8 * sizeof(unsigned long);
+
+			for (size_t bits = word_bits; bits <= 65536; bits *= 2)
+			{
+				std::vector<unsigned long> nodes(bits / word_bits);
+
+				if (syscall(SYS_get_mempolicy, nullptr, nodes.data(), bits + 1, nullptr, mpol_f_mems_allowed) == 0) // maxnode counts one extra bit (as in libnuma)
+					return nodes;
+
+				if (errno != EINVAL)
+					break;
+			}
+
+			record_numa_error(errno); // nodes are not known, so no range can be interleaved
+			return std::vector<unsigned long>();
+		}();
+
+		return mask;
+	}
+#endif
+
+	/** @brief Applies huge pages and interleaving of active settings to memory of given size which was not written yet.
+	*/
+	inline void prepare(void* memory, const size_t bytes)
+	{
+#ifdef __linux__
+		const settings& current = active();
+
+		if (!memory || bytes == 0 || (!current.huge_pages && current.numa != numa_policy::interleave))
+			return;
+
+		const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+		const uintptr_t begin = (reinterpret_cast<uintptr_t>(memory) + page - 1) / page * page; // whole pages inside memory only
+		const uintptr_t end = (reinterpret_cast<uintptr_t>(memory) + bytes) / page * page;
+
+		if (begin >= end)
+			return;
+
+		char* const pages = reinterpret_cast<char*>(begin);
+		const size_t length = end - begin;
+
+		if (current.huge_pages)
+			madvise(pages, length, MADV_HUGEPAGE); // kernel backs aligned 2 MB parts of range by huge pages (if they are not disabled)
+
+		if (current.numa == numa_policy::interleave)
+		{
+			const std::vector<unsigned long>& nodes = allowed_nodes();
+
+			if (!nodes.empty() && syscall(SYS_mbind, pages, length, mpol_interleave, nodes.data(), 8 * sizeof(unsigned long) * nodes.size() + 1, 0) != 0)
+				record_numa_error(errno);
+		}
+#else
+		(void)memory;
+		(void)bytes;
+#endif
+	}
+
+	/** @brief Applies first touch of active settings to constructed elements of array: every 2 MB chunk is moved
+	 *	to NUMA node of worker thread which takes it in parallel loop (pages of huge page are never split between threads).
+	*/
+	template <typename T, typename Allocator>
+	void distribute(std::vector<T, Allocator>& array)
+	{
+#ifdef __linux__
+		if (active().numa != numa_policy::first_touch || array.empty())
+			return;
+
+		const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+		const uintptr_t chunk = std::max<uintptr_t>(page, uintptr_t(2) << 20);
+		const uintptr_t memory = reinterpret_cast<uintptr_t>(array.data());
+		const uintptr_t begin = (memory + page - 1) / page * page; // whole pages inside array only
+		const uintptr_t end = (memory + array.size() * sizeof(T)) / page * page;
+
+		if (begin >= end)
+			return;
+
+		const uintptr_t first_chunk = begin / chunk;
+
+		parallel::for_each_chunk(0, (end - 1) / chunk - first_chunk + 1, 1, [&](const size_t first, const size_t last)
+		{
+			for (size_t k = first; k < last; ++k)
+			{
+				const uintptr_t chunk_begin = std::max(begin, (first_chunk + k) * chunk);
+				const uintptr_t chunk_end = std::min(end, (first_chunk + k + 1) * chunk);
+
+				if (syscall(SYS_mbind, reinterpret_cast<void*>(chunk_begin), chunk_end - chunk_begin, mpol_local, nullptr, 0, mpol_mf_move) != 0)
+					record_numa_error(errno);
+			}
+		});
+#else
+		(void)array;
+#endif
+	}
+
+	/** @brief Reserves capacity of vector and applies active settings to its part beyond current size (which was not written yet).
+	*/
+	template <typename T, typename Allocator>
+	void reserve(std::vector<T, Allocator>& array, const size_t capacity)
+	{
+		array.reserve(capacity);
+		prepare(array.data() + array.size(), (array.capacity() - array.size()) * sizeof(T));
+	}
+
+	/** @brief Bytes of anonymous memory of this process backed by transparent huge pages (0 if it is not known).
+	*/
+	inline size_t huge_page_bytes()
+	{
+#ifdef __linux__
+		std::ifstream status("/proc/self/smaps_rollup");
+		std::string key;
+
+		while (status >> key)
+		{
+			size_t kilobytes = 0;
+
+			if (key == "AnonHugePages:" && status >> kilobytes)
+				return kilobytes * 1024;
+
+			status.ignore(1 << 16, '\n');
+		}
+#endif
+		return 0;
+	}
+}
+#endif // MEMORY_PLACEMENT_HPP
@@ -0,0 +1,176 @@
+#ifndef NORMAL_ESTIMATION_HPP
+#define NORMAL_ESTIMATION_HPP
+#include "arena.hpp"
+#include "batch_search.hpp"
+#include "cancellation.hpp"
+#include "parallel.hpp"
+#include "point_cloud.hpp"
+#include "progress.hpp"
+#include "nanoflann.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/** @brief Estimation of normal vectors for point clouds which do not contain them.
+ *	Normal vector of point is eigenvector of smallest eigenvalue of covariance matrix of its k nearest neighbours (including point itself).
+*/
+namespace normal_estimation
+{
+	/** @brief Returns unit eigenvector of smallest eigenvalue of symmetric 3x3 matrix (a00 a01 a02 / a01 a11 a12 / a02 a12 a22).
+	 *	Eigenvalue is computed in closed form (trigonometric solution of characteristic polynomial) and eigenvector as largest
+	 *	cross product of rows of (A - lambda * I), so there are no iterations and almost no branches.
+	*/
+	inline void smallest_eigenvector(double a00, double a01, double a02, double a11, double a12, double a22, float normal[3])
+	{
+		// scale matrix to avoid loss of precision for very small or very large neighbourhoods
+		const double max_element = std::fmax(std::fmax(std::fmax(std::fabs(a00), std::fabs(a01)), std::fmax(std::fabs(a02), std::fabs(a11))), std::fmax(std::fabs(a12), std::fabs(a22)));
+
+		if (max_element <= 0)
+		{
+			normal[0] = 0;
+			normal[1] = 0;
+			normal[2] = 1;
+			return;
+		}
+
+		a00 /= max_element; a01 /= max_element; a02 /= max_element;
+		a11 /= max_element; a12 /= max_element; a22 /= max_element;
+
+		const double q = (a00 + a11 + a22) / 3;
+		const double p1 = a01 * a01 + a02 * a02 + a12 * a12;
+		const double p2 = (a00 - q) * (a00 - q) + (a11 - q) * (a11 - q) + (a22 - q) * (a22 - q) + 2 * p1;
+		const double p = std::sqrt(p2 / 6);
+
+		double lambda = q;
+
+		if (p > 1e-12)
+		{
+			// B = (A - q * I) / p; r = det(B) / 2
+			const double b00 = (a00 - q) / p, b11 = (a11 - q) / p, b22 = (a22 - q) / p;
+			const double b01 = a01 / p, b02 = a02 / p, b12 = a12 / p;
+			const double r = (b00 * (b11 * b22 - b12 * b12) - b01 * (b01 * b22 - b12 * b02) + b02 * (b01 * b12 - b11 * b02)) / 2;
+			const double phi = std::acos(std::fmin(1.0, std::fmax(-1.0, r))) / 3;
+
+			lambda = q + 2 * p * std::cos(phi + 2.0943951023931957); // smallest root (phi + 2 * pi / 3)
+		}
+
+		const double r0[3] = { a00 - lambda, a01, a02 };
+		const double r1[3] = { a01, a11 - lambda, a12 };
+		const double r2[3] = { a02, a12, a22 - lambda };
+
+		const double c01[3] = { r0[1] * r1[2] - r0[2] * r1[1], r0[2] * r1[0] - r0[0] * r1[2], r0[0] * r1[1] - r0[1] * r1[0] };
+		const double c02[3] = { r0[1] * r2[2] - r0[2] * r2[1], r0[2] * r2[0] - r0[0] * r2[2], r0[0] * r2[1] - r0[1] * r2[0] };
+		const double c12[3] = { r1[1] * r2[2] - r1[2] * r2[1], r1[2] * r2[0] - r1[0] * r2[2], r1[0] * r2[1] - r1[1] * r2[0] };
+
+		const double d01 = c01[0] * c01[0] + c01[1] * c01[1] + c01[2] * c01[2];
+		const double d02 = c02[0] * c02[0] + c02[1] * c02[1] + c02[2] * c02[2];
+		const double d12 = c12[0] * c12[0] + c12[1] * c12[1] + c12[2] * c12[2];
+
+		const double* best = d01 >= d02 && d01 >= d12 ? c01 : (d02 >= d12 ? c02 : c12);
+		const double best_length = std::sqrt(std::fmax(d01, std::fmax(d02, d12)));
+
+		if (best_length <= 0) // all points of neighbourhood are on one line; any perpendicular vector is valid
+		{
+			normal[0] = 0;
+			normal[1] = 0;
+			normal[2] = 1;
+			return;
+		}
+
+		for (int i = 0; i < 3; ++i)
+			normal[i] = static_cast<float>(best[i] / best_length);
+	}
+
+	/** @brief Sets normal vector of point from its found nearest neighbours (indices to cloud).
+	*/
+	inline void estimate_point(const point_cloud<float>& cloud, point& current, const point_index* indices, const size_t found, const float* viewpoint)
+	{
+		double mean[3]{};
+
+		for (size_t j = 0; j < found; ++j)
+		{
+			for (int d = 0; d < 3; ++d)
+				mean[d] += cloud.points[indices[j]].data[d];
+		}
+
+		for (int d = 0; d < 3; ++d)
+			mean[d] /= static_cast<double>(found);
+
+		double c00 = 0, c01 = 0, c02 = 0, c11 = 0, c12 = 0, c22 = 0;
+
+		for (size_t j = 0; j < found; ++j)
+		{
+			const float* neighbour = cloud.points[indices[j]].data;
+			const double x = neighbour[0] - mean[0], y = neighbour[1] - mean[1], z = neighbour[2] - mean[2];
+
+			c00 += x * x; c01 += x * y; c02 += x * z;
+			c11 += y * y; c12 += y * z; c22 += z * z;
+		}
+
+		float* normal = current.data + 6;
+		smallest_eigenvector(c00, c01, c02, c11, c12, c22, normal);
+
+		const float orientation = viewpoint
+			? normal[0] * (viewpoint[0] - current.data[0]) + normal[1] * (viewpoint[1] - current.data[1]) + normal[2] * (viewpoint[2] - current.data[2])
+			: normal[2];
+
+		if (orientation < 0)
+		{
+			for (int d = 0; d < 3; ++d)
+				normal[d] = -normal[d];
+		}
+	}
+
+	/** @brief Estimates normal vectors of all points of cloud in parallel using k nearest neighbours found in built K-D tree.
+	 *	Points are processed in order of leaves of tree and neighbours of every block of them are found by one batched query (see batch_search).
+	 *	Sign of normal vectors is chosen so they point towards viewpoint (coordinates relative to origin of cloud),
+	 *	or upwards (positive Z) if there is no viewpoint. Sets has_normals of cloud. Throws cancellation::cancelled_error if run is cancelled.
+	*/
+	template <typename Tree>
+	void estimate(point_cloud<float>& cloud, const Tree& tree, const size_t number_of_neighbours, const float* viewpoint = nullptr)
+	{
+		const size_t k = std::max<size_t>(3, number_of_neighbours);
+
+		parallel::for_each_chunk(0, cloud.points.size(), 4096, [&](const size_t begin, const size_t end)
+		{
+			cancellation::shared_token().throw_if_cancelled();
+
+			arena::scope chunk_memory; // buffers of searcher and batches
+			batch_search::searcher<Tree> searcher(tree);
+			arena::vector<point_index> indices(batch_search::default_batch_size * k);
+			arena::vector<float> distances(batch_search::default_batch_size * k);
+			arena::vector<const float*> queries;
+			arena::vector<nanoflann::KNNResultSet<float, point_index>> result_sets;
+
+			for (size_t batch_begin = begin; batch_begin < end; batch_begin += batch_search::default_batch_size)
+			{
+				const size_t batch_end = std::min(end, batch_begin + batch_search::default_batch_size);
+
+				queries.clear();
+				result_sets.clear();
+
+				for (size_t position = batch_begin; position < batch_end; ++position)
+				{
+					const size_t b = position - batch_begin;
+
+					queries.push_back(cloud.points[tree.vind[position]].data);
+					result_sets.emplace_back(k);
+					result_sets.back().init(indices.data() + b * k, distances.data() + b * k);
+				}
+
+				searcher.find_neighbours(queries.data(), queries.size(), result_sets.data());
+
+				for (size_t position = batch_begin; position < batch_end; ++position)
+				{
+					const size_t b = position - batch_begin;
+					estimate_point(cloud, cloud.points[tree.vind[position]], indices.data() + b * k, result_sets[b].size(), viewpoint);
+				}
+			}
+
+			progress::shared_reporter().advance(end - begin);
+		});
+
+		cloud.has_normals = true;
+	}
+}
+#endif // NORMAL_ESTIMATION_HPP
@@ -0,0 +1,253 @@
+#ifndef OCTREE_HPP
+#define OCTREE_HPP
+#include "instrumentation.hpp"
+#include "parallel.hpp"
+#include "point_cloud.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** @brief Octree tiling of (reduced) point cloud for level-of-detail streaming.
+ *	Every node keeps coarse sample of its points (first point in every cell of sampling grid laid over node),
+ *	remaining points are passed to its 8 children, so viewer gets whole area in low detail from few top nodes.
+ *	Nodes with at most max_node_points points are leaves and keep all of them.
+ *	Nodes of one level are built in parallel.
+ *
+ *	Points of all nodes are written to one binary file (node after node in breadth-first order) and index file (JSON)
+ *	describes every node by name ("r" followed by numbers of children on path from root), bounding cube, byte offset and number of points.
+ *	Point record has 28 bytes: x, y, z as float (relative to origin of cloud), red, green, blue and padding as uchar, nx, ny, nz as float.
+*/
+class octree
+{
+public:
+	static const size_t record_size = 28;
+	static const int sampling_resolution = 128; // cells of sampling grid along every axis of node
+	static const int max_depth = 20;
+
+	struct node
+	{
+		std::string name;
+		int level = 0;
+		float min[3]{};
+		float size = 0; // edge of bounding cube
+		std::vector<point_index> points; // indices to points of cloud kept by this node
+		std::vector<point_index> pending; // points of subtree not placed yet (used while building)
+		std::vector<std::vector<point_index>> child_pending; // pending points of children in 2 x 2 x 2 grid (used while building)
+		int children[8]{ -1, -1, -1, -1, -1, -1, -1, -1 }; // indices to nodes
+		uint64_t offset = 0; // byte offset of points in binary file
+	};
+
+	std::vector<node> nodes; // breadth-first order, nodes[0] is root
+
+	/** @brief Builds octree over given points of cloud.
+	*/
+	void build(const point_cloud<float>& cloud, const std::vector<point_index>& point_indices, const size_t max_node_points)
+	{
+		nodes.clear();
+
+		if (point_indices.empty())
+			return;
+
+		node root;
+		root.name = "r";
+		float max[3];
+
+		for (int d = 0; d < 3; ++d)
+			root.min[d] = max[d] = cloud.points[point_indices[0]].data[d];
+
+		for (const point_index i : point_indices)
+		{
+			for (int d = 0; d < 3; ++d)
+			{
+				root.min[d] = std::min(root.min[d], cloud.points[i].data[d]);
+				max[d] = std::max(max[d], cloud.points[i].data[d]);
+			}
+		}
+
+		root.size = std::max(max[0] - root.min[0], std::max(max[1] - root.min[1], max[2] - root.min[2]));
+		root.size = root.size > 0 ? root.size * 1.0001f : 1; // points on maximum must be inside cube
+		root.pending = point_indices;
+		nodes.push_back(std::move(root));
+
+		size_t level_begin = 0;
+
+		while (level_begin < nodes.size())
+		{
+			const size_t level_end = nodes.size();
+
+			parallel::for_each_chunk(level_begin, level_end, 1, [&](const size_t begin, const size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					distribute(cloud, nodes[i], max_node_points);
+			});
+
+			// children are appended after all nodes of level are distributed, so nodes are not moved while they are processed
+			for (size_t i = level_begin; i < level_end; ++i)
+				add_children(i);
+
+			level_begin = level_end;
+		}
+	}
+
+	/** @brief Writes points of all nodes to binary file and description of nodes to index file. Origin is origin of cloud.
+	*/
+	void write(const point_cloud<float>& cloud, const std::string& binary_file_name, const std::string& index_file_name)
+	{
+		std::ofstream binary_file(binary_file_name, std::ios::binary);
+
+		if (!binary_file)
+			throw std::runtime_error("Could not create file " + binary_file_name);
+
+		uint64_t offset = 0;
+		std::vector<char> buffer;
+
+		for (node& current : nodes)
+		{
+			current.offset = offset;
+			buffer.resize(current.points.size() * record_size);
+
+			for (size_t i = 0; i < current.points.size(); ++i)
+				write_record(cloud.points[current.points[i]], buffer.data() + i * record_size);
+
+			binary_file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			offset += buffer.size();
+		}
+
+		if (!binary_file)
+			throw std::runtime_error("Could not write file " + binary_file_name);
+
+		std::ofstream index_file(index_file_name);
+
+		if (!index_file)
+			throw std::runtime_error("Could not create file " + index_file_name);
+
+		index_file << std::setprecision(9) << "{\n  \"version\": 1, \"record_size\": " << record_size
+			<< ", \"record\": [\"x:float\", \"y:float\", \"z:float\", \"red:uchar\", \"green:uchar\", \"blue:uchar\", \"padding:uchar\", \"nx:float\", \"ny:float\", \"nz:float\"],\n"
+			<< "  \"origin\": [" << std::setprecision(15) << cloud.origin[0] << ", " << cloud.origin[1] << ", " << cloud.origin[2] << "]," << std::setprecision(9)
+			<< " \"binary_file\": " << instrumentation::json_string(file_name_only(binary_file_name)) << ",\n  \"nodes\": [";
+
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			const node& current = nodes[i];
+			index_file << (i ? "," : "") << "\n    { \"name\": \"" << current.name << "\", \"level\": " << current.level
+				<< ", \"min\": [" << current.min[0] << ", " << current.min[1] << ", " << current.min[2] << "], \"size\": " << current.size
+				<< ", \"offset\": " << current.offset << ", \"points\": " << current.points.size() << " }";
+		}
+
+		index_file << "\n  ]\n}\n";
+	}
+
+private:
+	/** @brief Keeps sample of pending points in node and distributes rest to pending points of its children (created later by add_children).
+	*/
+	void distribute(const point_cloud<float>& cloud, node& current, const size_t max_node_points)
+	{
+		std::vector<point_index> pending;
+		pending.swap(current.pending);
+
+		if (pending.size() <= max_node_points || current.level >= max_depth)
+		{
+			current.points = std::move(pending);
+			return;
+		}
+
+		std::vector<bool> is_occupied(static_cast<size_t>(sampling_resolution) * sampling_resolution * sampling_resolution);
+		std::vector<point_index> rest;
+		rest.reserve(pending.size());
+
+		std::vector<point_index> sample;
+
+		for (const point_index i : pending)
+		{
+			const size_t cell = cell_index(cloud.points[i], current.min, current.size, sampling_resolution);
+
+			if (!is_occupied[cell])
+			{
+				is_occupied[cell] = true;
+				sample.push_back(i);
+			}
+			else
+				rest.push_back(i);
+		}
+
+		// too large sample is thinned evenly, so node still covers its whole cube
+		for (size_t j = 0, kept = 0; j < sample.size(); ++j)
+		{
+			if (kept < max_node_points && j * max_node_points >= kept * sample.size())
+			{
+				current.points.push_back(sample[j]);
+				kept++;
+			}
+			else
+				rest.push_back(sample[j]);
+		}
+
+		current.child_pending.resize(8);
+
+		for (const point_index i : rest)
+			current.child_pending[cell_index(cloud.points[i], current.min, current.size, 2)].push_back(i);
+	}
+
+	/** @brief Creates children of node for its non-empty child_pending lists.
+	*/
+	void add_children(const size_t parent_index)
+	{
+		for (int c = 0; c < 8 && !nodes[parent_index].child_pending.empty(); ++c)
+		{
+			if (nodes[parent_index].child_pending[c].empty())
+				continue;
+
+			node child;
+			const node& parent = nodes[parent_index];
+
+			child.name = parent.name + std::to_string(c);
+			child.level = parent.level + 1;
+			child.size = parent.size / 2;
+			child.pending = std::move(nodes[parent_index].child_pending[c]);
+
+			for (int d = 0; d < 3; ++d)
+				child.min[d] = parent.min[d] + ((c >> d) & 1) * child.size; // bit d of child number is set for upper half along axis d
+
+			nodes[parent_index].children[c] = static_cast<int>(nodes.size());
+			nodes.push_back(std::move(child));
+		}
+
+		nodes[parent_index].child_pending.clear();
+		nodes[parent_index].child_pending.shrink_to_fit();
+	}
+
+	static size_t cell_index(const point& p, const float min[3], const float size, const int resolution)
+	{
+		size_t cell = 0;
+
+		for (int d = 2; d >= 0; --d)
+		{
+			const int coordinate = std::min(resolution - 1, std::max(0, static_cast<int>((p.data[d] - min[d]) / size * resolution)));
+			cell = cell * resolution + coordinate;
+		}
+
+		return cell;
+	}
+
+	static std::string file_name_only(const std::string& path)
+	{
+		const size_t separator = path.find_last_of("/\\");
+
+		return separator == std::string::npos ? path : path.substr(separator + 1);
+	}
+
+	static void write_record(const point& p, char* record)
+	{
+		const unsigned char colors[4] = { static_cast<unsigned char>(p.data[3]), static_cast<unsigned char>(p.data[4]), static_cast<unsigned char>(p.data[5]), 0 };
+
+		std::memcpy(record, p.data, 3 * sizeof(float));
+		std::memcpy(record + 12, colors, 4);
+		std::memcpy(record + 16, p.data + 6, 3 * sizeof(float));
+	}
+};
+#endif // OCTREE_HPP
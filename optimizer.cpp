@@ -0,0 +1,1016 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include "point.hpp"
+#include <sstream>
+#include <iomanip>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include "optimizer.hpp"
+#include "arena.hpp"
+#include "memory_placement.hpp"
+#include "instrumentation.hpp"
+#include "ply_reader.hpp"
+#include "las_reader.hpp"
+#include "cloud_cache.hpp"
+#include "normal_estimation.hpp"
+#include "space_interval_search.hpp"
+#include "octree.hpp"
+#include "claim_index.hpp"
+#include "implicit_kd_tree.hpp"
+#include "batch_search.hpp"
+#include "progress.hpp"
+#include "cancellation.hpp"
+
+using namespace std;
+using namespace nanoflann;
+
+point_cloud<float> cloud;
+vector<cluster> initial_clusters;
+vector<cluster> new_clusters;
+vector<point> representatives;
+vector<point_index> original_indices;
+seed_graph seed_adjacency;
+
+float space_interval_dt;
+float vector_deviation_nt;
+
+bool use_cache = false;
+bool morton_order = false;
+bool leaf_order = false;
+bool mean_representatives = false;
+bool use_claim_index = false;
+bool use_implicit_tree = false;
+size_t normal_neighbours = 16;
+bool has_viewpoint = false;
+double viewpoint[3]{};
+bool record_seed_graph = false;
+
+subdivision_statistics statistics;
+
+/** @brief Returns lower-case extension of file name (including dot) or empty string if file name has no extension.
+*/
+string file_extention(const string& file_name)
+{
+	const size_t dot = file_name.find_last_of('.');
+
+	if (dot == string::npos || file_name.find_first_of("/\\", dot) != string::npos)
+		return "";
+
+	string extention = file_name.substr(dot);
+	transform(extention.begin(), extention.end(), extention.begin(), [](const unsigned char c) { return static_cast<char>(tolower(c)); });
+
+	return extention;
+}
+
+/** @brief Decides whether file name has extension of supported input format (.ply or .las).
+*/
+bool is_supported_file(const string& file_name)
+{
+	const string extention = file_extention(file_name);
+
+	return extention == file_name_extention || extention == las_file_name_extention;
+}
+
+/** @brief Creates reader for format of input file. Format is decided by file extension.
+ *	.las files are read by las_reader (LAS 1.2 - 1.4), all other files by ply_reader.
+ *
+ *	.ply file is expected to comply .ply standards and to contain "vertex" element with at least these properties (in any order):
+
+property float x
+property float y
+property float z
+property uchar red
+property uchar green
+property uchar blue
+property float nx
+property float ny
+property float nz
+
+Coordinates may also be stored as double. Colors and normal vectors are optional (see ply_reader).
+Other elements, properties and comments are ignored and are not transfered into output file.
+*/
+unique_ptr<point_cloud_reader> create_reader(const string& file_name)
+{
+	if (file_extention(file_name) == las_file_name_extention)
+		return unique_ptr<point_cloud_reader>(new las_reader());
+
+	return unique_ptr<point_cloud_reader>(new ply_reader());
+}
+
+/** @brief Returns size of file in bytes or 0 if file could not be opened.
+*/
+uint64_t file_size(const string& file_name)
+{
+	const streamoff size = ifstream(file_name, ios::binary | ios::ate).tellg();
+
+	return size > 0 ? static_cast<uint64_t>(size) : 0;
+}
+
+/** @brief Parses point cloud from external file using reader for its format.
+ *	If cache is enabled, valid cache file of input file is read instead and missing or outdated cache is written after parsing.
+ *	Throws if cloud has more points than point_index can address.
+*/
+void import_point_cloud(const string& file_name)
+{
+	const string cache_file_name = file_name + cache_file_name_extention;
+
+	if (use_cache && cloud_cache::is_valid(cache_file_name, file_name, morton_order))
+	{
+		progress::shared_reporter().begin_stage("import", file_size(cache_file_name), "bytes");
+
+		cout << endl << "Loading cached point cloud: " + cache_file_name << endl;
+
+		cloud_cache::reader().read(cache_file_name, cloud);
+	}
+	else
+	{
+		progress::shared_reporter().begin_stage("import", file_size(file_name), "bytes");
+
+		cout << endl << "Importing and parsing file: " + file_name << endl;
+
+		create_reader(file_name)->read(file_name, cloud);
+
+		if (morton_order)
+			cloud_cache::sort_by_morton_code(cloud);
+
+		if (use_cache)
+		{
+			cout << "Writing cache file: " + cache_file_name << endl;
+
+			try
+			{
+				cloud_cache::write(cache_file_name, file_name, cloud, morton_order);
+			}
+			catch (const std::exception& e)
+			{
+				cout << "Warning! Cache file was not written (" << e.what() << ")." << endl;
+			}
+		}
+	}
+
+	if (cloud.points.size() > numeric_limits<point_index>::max())
+		throw runtime_error("Point cloud has more points than 32-bit point indices can address (build with POCO_INDEX_64).");
+
+	memory_placement::distribute(cloud.points);
+}
+
+/** @brief Permutes points of cloud to order of their indices in K-D tree (vind of nanoflann), so points of every leaf
+ *	are continuous block of memory and leaf scans read points sequentially instead of jumping through vind.
+ *	Tree is then updated to identity permutation. Original index of every point is kept in original_indices.
+*/
+void leaf_order_stage(tree& my_tree)
+{
+	progress::shared_reporter().begin_stage("leaf_order", cloud.points.size(), "points");
+
+	cout << "Reordering points to order of K-D tree leaves." << endl;
+
+	vector<point> ordered_points;
+	memory_placement::reserve(ordered_points, cloud.points.size());
+
+	for (const size_t i : my_tree.vind)
+		ordered_points.push_back(cloud.points[i]);
+
+	cloud.points.swap(ordered_points);
+	memory_placement::distribute(cloud.points);
+
+	original_indices = my_tree.vind;
+	iota(my_tree.vind.begin(), my_tree.vind.end(), point_index(0));
+
+	progress::shared_reporter().set(cloud.points.size());
+}
+
+/** @brief Order in which cluster initialization visits points as seeds: seeds[k] is k-th visited point.
+ *	Points reordered to leaf order are visited in their original (import) order; empty vector means import order of cloud itself.
+*/
+vector<point_index> seed_order()
+{
+	vector<point_index> seeds(original_indices.size());
+
+	for (size_t i = 0; i < original_indices.size(); ++i)
+		seeds[original_indices[i]] = static_cast<point_index>(i);
+
+	return seeds;
+}
+
+/** @brief Searches Space Interval Threshold (DT) for which cluster initialization creates approximately target number of clusters
+ *	(subdivision by Normal Vector Deviation Threshold (NT) may add more). Few passes of voxel count estimator are followed
+ *	by few greedy counts of initial clusters with given K-D tree, so full reduction is run only once with returned DT.
+ *	If run is cancelled during counts, DT of voxel estimator is returned.
+*/
+float space_interval_search_stage(const tree& my_tree, size_t target_points)
+{
+	progress::shared_reporter().begin_stage("space_interval_search", 0, "passes");
+
+	cout << "Searching Space Interval Threshold (DT) for " << target_points << " points." << endl;
+
+	const float extent = space_interval_search::largest_extent(cloud);
+	target_points = max<size_t>(1, min(target_points, cloud.points.size()));
+
+	if (extent <= 0) // all points are equal
+		return 1;
+
+	auto report_pass = [](const char* estimator)
+	{
+		return [estimator](const float dt, const double count)
+		{
+			cout << "  DT = " << dt << ": " << static_cast<size_t>(count) << " clusters (" << estimator << ")" << endl;
+			progress::shared_reporter().advance(1);
+		};
+	};
+
+	double slope = -2; // surfaces
+	float dt = extent / sqrt(static_cast<float>(target_points));
+
+	dt = space_interval_search::secant_search([](const float space_interval) { return space_interval_search::count_occupied_voxels(cloud, space_interval * space_interval_search::voxel_edge_per_space_interval); },
+		dt, target_points, 0.01, 8, slope, report_pass("voxel estimate"));
+
+	const vector<point_index> seeds = seed_order(); // counts visit seeds in same order as cluster initialization
+
+	try
+	{
+		dt = space_interval_search::secant_search([&my_tree, &seeds](const float space_interval) { return space_interval_search::count_initial_clusters(cloud, my_tree, space_interval, seeds); },
+			dt, target_points, 0.02, 4, slope, report_pass("initial clusters"));
+	}
+	catch (const cancellation::cancelled_error&)
+	{
+		cout << "Run was cancelled; DT of voxel estimate is used." << endl;
+	}
+
+	cout << "Using Space Interval Threshold (DT) " << dt << "." << endl;
+
+	return dt;
+}
+
+/** @brief Estimates normal vectors for clouds imported without them, so they can be divided by Normal Vector Deviation Threshold (NT).
+*/
+void normal_estimation_stage(const tree& my_tree)
+{
+	if (cloud.has_normals)
+		return;
+
+	progress::shared_reporter().begin_stage("normal_estimation", cloud.points.size(), "points");
+
+	cout << "Estimating normal vectors." << endl;
+
+	float local_viewpoint[3];
+
+	for (int i = 0; i < 3; ++i)
+		local_viewpoint[i] = static_cast<float>(viewpoint[i] - cloud.origin[i]);
+
+	normal_estimation::estimate(cloud, my_tree, normal_neighbours, has_viewpoint ? local_viewpoint : nullptr);
+}
+
+/** @brief Coordinates of clouds with local origin are exported in double precision.
+*/
+bool has_local_origin()
+{
+	return cloud.origin[0] != 0 || cloud.origin[1] != 0 || cloud.origin[2] != 0;
+}
+
+/** @brief Writes point (coordinates, color and normal vector) as one line of exported file (without end of line).
+*/
+void write_point(ostream& output, const point& p, const bool has_origin)
+{
+	for (size_t j = 0; j < 9; ++j)
+	{
+		if (has_origin && j < 3)
+			output << std::setprecision(15) << p.data[j] + cloud.origin[j];
+		else
+			output << std::setprecision(7) << p.data[j];
+
+		if (j < 8)
+			output << ' ';
+	}
+}
+
+/** @brief Estimated time of export of given number of points. Cost of one point is measured once by formatting sample of points
+ *	as export does (with margin for writing file).
+*/
+double export_seconds(const size_t output_points)
+{
+	static double seconds_per_point = 0;
+
+	if (seconds_per_point == 0 && !cloud.points.empty())
+	{
+		const size_t sample = min<size_t>(1024, cloud.points.size());
+		const bool has_origin = has_local_origin();
+		stringstream sample_stream;
+
+		const auto start = chrono::steady_clock::now();
+
+		for (size_t i = 0; i < sample; ++i)
+		{
+			write_point(sample_stream, cloud.points[i * (cloud.points.size() / sample)], has_origin);
+			sample_stream << '\n';
+		}
+
+		seconds_per_point = 1.5 * chrono::duration<double>(chrono::steady_clock::now() - start).count() / sample;
+	}
+
+	return seconds_per_point * output_points;
+}
+
+chrono::steady_clock::time_point earliest_finish; // earliest estimated end of export in current stage (see is_cancelled_before_export)
+
+/** @brief Polls cancellation of stage whose result would have given number of points if it stopped now.
+ *	Export of result is not cancelled, so time for it is kept at end of time budget (see cancellation::token::reserve).
+ *	While work shortens export by more than it takes (e.g. initialization, whose every cluster saves export of many points),
+ *	stopping could only finish later, so stage continues even if budget cannot be kept; explicit cancellation stops it always.
+*/
+bool is_cancelled_before_export(const size_t output_points)
+{
+	cancellation::token& token = cancellation::shared_token();
+
+	if (!token.has_time_budget() || token.is_requested())
+		return token.is_cancelled();
+
+	const double seconds = export_seconds(output_points);
+	const auto finish = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+
+	if (finish < earliest_finish)
+	{
+		earliest_finish = finish;
+		return false;
+	}
+
+	token.reserve(seconds);
+
+	return token.is_cancelled();
+}
+
+/** @brief Tells claim-aware index that point belongs to cluster, so it is not searched anymore. Other trees do not track claims.
+*/
+template <typename Tree>
+void claim_point(const Tree& /* my_tree */, const point_index /* index */)
+{
+}
+
+void claim_point(claim_index& my_tree, const point_index index)
+{
+	my_tree.claim(index);
+}
+
+/** @brief Creates initial clusters from points of K-D tree. Cloud_index(k) maps index k of tree to index of point in cloud
+ *	and points are visited in order of tree indices seed_index(0), seed_index(1), ... If point is not marked, it becames centroid of new cluster.
+ *	This new cluster contains non-marked neighbours of centroid whose distance is less than or equal to Space Interval Threshold (DT).
+ *	If run is cancelled, every remaining non-marked point becomes cluster of its own, so all points are still covered by clusters.
+ *	If record_seed_graph is set, centroids of clusters are also added to seed_adjacency as they are created (see seed_graph).
+*/
+template <typename Tree, typename SeedIndex, typename CloudIndex>
+void initialize_clusters(Tree& my_tree, const size_t number_of_points, const SeedIndex& seed_index, const CloudIndex& cloud_index)
+{
+	progress::reporter& stage_progress = progress::shared_reporter();
+	stage_progress.begin_stage("initialization", number_of_points, "points");
+
+	cout << "Initializing clusters." << endl;
+
+	bool cancelled = false;
+	size_t points_not_clustered = 0;
+	size_t points_clustered = 0;
+	earliest_finish = chrono::steady_clock::time_point::max();
+
+	const float radius = space_interval_dt * space_interval_dt; // L2_Simple_Adaptor works with squared distances (DT itself is radius, not sqrt(DT))
+	vector<std::pair<point_index, float>> indices_dists; // reused by all searches, so it is allocated only few times
+
+	if (record_seed_graph)
+		seed_adjacency.begin(3 * space_interval_dt * space_interval_dt); // same squared radius as boundary detection
+	else
+		seed_adjacency.clear();
+
+	for (size_t k = 0; k < number_of_points; ++k)
+	{
+		stage_progress.set(k);
+
+		if (!cancelled && k % 1024 == 0)
+			cancelled = is_cancelled_before_export(initial_clusters.size() + number_of_points - points_clustered); // points left now would be exported one by one
+
+		const size_t i = cloud_index(seed_index(k));
+
+		if (cancelled && !cloud.points[i].is_marked)
+		{
+			cloud.points[i].is_centroid = true;
+			cloud.points[i].is_marked = true;
+			initial_clusters.push_back({ static_cast<point_index>(i) });
+			points_not_clustered++;
+
+			if (record_seed_graph)
+				seed_adjacency.add_seed(cloud.points[i].data);
+		}
+		else if (!cloud.points[i].is_marked)
+		{
+			cloud.points[i].is_centroid = true;
+
+			float* centroid = cloud.points[i].data; // index to centroid is at index 0 in cluster
+
+			if (record_seed_graph)
+				seed_adjacency.add_seed(centroid);
+
+			my_tree.radiusSearch(centroid, radius, indices_dists, SearchParams());
+
+			// create new cluster
+			initial_clusters.resize(initial_clusters.size() + 1);
+			cluster& current_cluster = initial_clusters[initial_clusters.size() - 1];
+			current_cluster.reserve(indices_dists.size());
+
+			// fill the new cluster
+			for (size_t j = 0; j < indices_dists.size(); ++j)
+			{
+				const point_index member = cloud_index(indices_dists[j].first);
+
+				if (!cloud.points[member].is_marked) // do not copy indices to marked points to cluster; they already are in another cluster
+				{
+					current_cluster.push_back(member);
+					cloud.points[member].is_marked = true;
+					claim_point(my_tree, member);
+					points_clustered++;
+				}
+			}
+		}
+	}
+
+	stage_progress.set(number_of_points);
+
+	if (record_seed_graph)
+		seed_adjacency.finish();
+
+	if (cancelled)
+		cout << "Run was cancelled; " << points_not_clustered << " points were left without clustering." << endl;
+}
+
+/** @brief Creates initial clusters from all points of cloud (see initialize_clusters).
+ *	Points reordered to leaf order are visited in their original order, so clusters are same as without reordering.
+ *	With claim-aware index, points already claimed by clusters are pruned from searches instead of being found and skipped.
+ *	With implicit K-D tree, neighbours are searched in pointer-free tree built for this stage instead of given tree.
+*/
+void cluster_initialization(const tree& my_tree)
+{
+	vector<point_index> seeds = seed_order();
+
+	if (seeds.empty())
+	{
+		seeds.resize(cloud.points.size());
+		iota(seeds.begin(), seeds.end(), point_index(0));
+	}
+
+	auto seed_index = [&seeds](const size_t k) { return seeds[k]; };
+	auto cloud_index = [](const point_index i) { return i; };
+
+	if (use_implicit_tree)
+	{
+		implicit_kd_tree compact_tree(cloud, 50);
+		compact_tree.build();
+
+		cout << "Implicit K-D tree holds " << compact_tree.memory_bytes() / static_cast<double>(1 << 20) << " MB." << endl;
+
+		initialize_clusters(compact_tree, cloud.points.size(), seed_index, cloud_index);
+		return;
+	}
+
+	if (!use_claim_index)
+	{
+		initialize_clusters(my_tree, cloud.points.size(), seed_index, cloud_index);
+		return;
+	}
+
+	claim_index unclaimed_points(cloud);
+	unclaimed_points.build(my_tree);
+
+	for (size_t i = 0; i < cloud.points.size(); ++i) // e.g. clouds with marks from previous run
+	{
+		if (cloud.points[i].is_marked)
+			unclaimed_points.claim(static_cast<point_index>(i));
+	}
+
+	initialize_clusters(unclaimed_points, cloud.points.size(), seed_index, cloud_index);
+}
+
+/** @brief Creates initial clusters of next (coarser) level of detail with current Space Interval Threshold (DT).
+ *	Only centroids of new_clusters of previous level are clustered, using K-D tree built over these centroids,
+ *	so coarser level costs only fraction of first one. Previous clusters and subdivision statistics are replaced.
+*/
+void level_of_detail_initialization()
+{
+	point_subset<float> centroids(cloud);
+	centroids.indices.reserve(new_clusters.size());
+
+	for (const cluster& previous_cluster : new_clusters)
+	{
+		const point_index centroid = previous_cluster[0]; // index to centroid is at index 0 in cluster
+
+		// other points stay marked, so they are not clustered again
+		cloud.points[centroid].is_marked = false;
+		cloud.points[centroid].is_centroid = false;
+		centroids.indices.push_back(centroid);
+	}
+
+	initial_clusters.clear();
+	new_clusters.clear();
+	representatives.clear();
+	statistics.clear(); // statistics describe subdivision of one level only
+
+	subset_tree centroid_tree(point::dimension, centroids, KDTreeSingleIndexAdaptorParams(10));
+	centroid_tree.buildIndex();
+
+	initialize_clusters(centroid_tree, centroids.indices.size(), [](const size_t k) { return k; }, [&centroids](const point_index k) { return centroids.indices[k]; });
+}
+
+/** @brief Standard deviation of normal vectors of 2 points. Normal vectors are expected to be normalized, therefore return value is between 0 and 1.
+ *	Deviation is based on Euclidian distance
+*/
+float standard_deviation(const point& p1, const point& p2)
+{
+	float sum = 0;
+
+	for (size_t i = 6; i < 6 + point::dimension; ++i) // normal vector coordinates are in array on indices 6, 7 and 8
+		sum += pow(p1.data[i] - p2.data[i], 2);
+
+	return sqrt(sum / 2);
+}
+
+// indicator returned by new_means if cluster should not be divided
+const pair<point_index, point_index> no_division(numeric_limits<point_index>::max(), numeric_limits<point_index>::max());
+
+// part of cluster during its subdivision, allocated in arena of thread (released when scope of divided cluster ends, see arena)
+typedef arena::vector<point_index> transient_cluster;
+
+/** @brief Returns new means (indices to cluster of pair of points with largest deviation of normal vectors).
+ *	If this deviation is larger than Normal Vector Deviation Threshold (NT), cluster should be divided.
+ *	Returns no_division as indicator if cluster should not be divided (also if run is cancelled during evaluation of large cluster).
+*/
+template <typename Cluster>
+pair<point_index, point_index> new_means(const Cluster& cluster)
+{
+	// cluster with 1 member should not be divided; cluster division can be skipped if vector_deviation_nt is too close to 1
+	if (cluster.size() <= 1 || vector_deviation_nt > 0.99999)
+		return no_division;
+
+	float max_deviation = 0;
+	point_index max_index1 = 0, max_index2 = 0;
+
+	const bool is_large = cluster.size() >= 256; // only evaluation of large clusters takes long enough to be worth of polling for cancellation
+
+	for (size_t i = 0; i < cluster.size() - 1; ++i)
+	{
+		if (is_large && i % 64 == 0 && cancellation::shared_token().is_cancelled())
+			return no_division;
+
+		for (size_t j = i + 1; j < cluster.size(); ++j)
+		{
+			const float local_deviation = standard_deviation(cloud.points[cluster[i]], cloud.points[cluster[j]]);
+
+			if (local_deviation > max_deviation)
+			{
+				max_deviation = local_deviation;
+				max_index1 = static_cast<point_index>(i);
+				max_index2 = static_cast<point_index>(j);
+			}
+		}
+	}
+
+	if (max_deviation >= vector_deviation_nt)
+		return { max_index1, max_index2 }; // indices to cluster of pair of points with largest deviation of normal vectors 
+	else
+		return no_division;
+}
+
+/** @brief Simplified k-means clustering algorithm with k=2, non-moving predetermined centroid and 1 iteration.
+ *	Parts are allocated in arena of calling thread.
+*/
+template <typename Cluster>
+pair<transient_cluster, transient_cluster> k_means_clustering(const Cluster& init_cluster, const pair<point_index, point_index>& means)
+{
+	transient_cluster temp1, temp2;
+	temp1.reserve(init_cluster.size());
+	temp2.reserve(init_cluster.size());
+
+	temp1.push_back(init_cluster[means.first]);
+	temp2.push_back(init_cluster[means.second]);
+
+	for (size_t i = 0; i < init_cluster.size(); ++i)
+	{
+		if (i == means.first || i == means.second) // means are already at beginnings of temporary clusters
+			continue;
+
+		const double distance_to_mean1 = cloud.points[init_cluster[i]].distance(cloud.points[init_cluster[means.first]]);
+		const double distance_to_mean2 = cloud.points[init_cluster[i]].distance(cloud.points[init_cluster[means.second]]);
+
+		if (distance_to_mean1 < distance_to_mean2)
+			temp1.push_back(init_cluster[i]);
+		else
+			temp2.push_back(init_cluster[i]);
+	}
+
+	return { move(temp1), move(temp2) };
+}
+
+/** @brief Result set for radiusSearch which only counts found points and stops search when limit is reached.
+*/
+class neighbour_counter
+{
+public:
+	neighbour_counter(const float squared_radius, const size_t limit) : radius(squared_radius), count_limit(limit)
+	{
+	}
+
+	size_t size() const { return count; }
+
+	bool full() const { return true; }
+
+	bool addPoint(const float dist, const point_index /* index */)
+	{
+		if (dist < radius)
+			count++;
+
+		return count < count_limit;
+	}
+
+	float worstDist() const { return radius; }
+
+private:
+	const float radius;
+	const size_t count_limit;
+	size_t count = 0;
+};
+
+/** @brief Cluster is boundary if there are less than 6 other centroids in vicinity of sqrt(3) * space_interval_dt.
+ *	K-D tree contains only centroids of initial clusters (index i refers to centroid of initial_clusters[i]).
+ *	Clusters cluster_indices[0] to cluster_indices[count - 1] are tested together by one batched query (see batch_search).
+*/
+void detect_boundary_clusters(const point_index* cluster_indices, const size_t count, batch_search::searcher<subset_tree>& searcher, vector<char>& is_boundary)
+{
+	const float radius = 3 * space_interval_dt * space_interval_dt; // squared sqrt(3) * space_interval_dt
+
+	arena::vector<const float*> centroids(count);
+	arena::vector<neighbour_counter> counters(count, neighbour_counter(radius, 7));
+
+	for (size_t k = 0; k < count; ++k)
+		centroids[k] = cloud.points[initial_clusters[cluster_indices[k]][0]].data; // index to centroid is at index 0 in cluster
+
+	searcher.find_neighbours(centroids.data(), count, counters.data());
+
+	// centroid of cluster itself is always found too - that one does not count to neighbouring centroids count
+	for (size_t k = 0; k < count; ++k)
+		is_boundary[cluster_indices[k]] = counters[k].size() < 7;
+}
+
+/** @brief Returns indices to clusters which are boundary clusters.
+ *	If cluster initialization recorded seed_adjacency, neighbouring centroids are counted in this graph without any search.
+ *	Otherwise clusters are tested in parallel against K-D tree built over their centroids only.
+ *	Clusters are batched in order of leaves of this tree, so clusters of one batch are close to each other.
+*/
+vector<size_t> boundary_cluster_detection()
+{
+	progress::shared_reporter().begin_stage("boundary_detection", initial_clusters.size(), "clusters");
+
+	cout << "Detecting boundary clusters." << endl;
+
+	vector<size_t> cluster_indices;
+
+	if (seed_adjacency.size() == initial_clusters.size() && !initial_clusters.empty())
+	{
+		// centroid of cluster itself is not in graph, so cluster is boundary if it has less than 6 neighbouring centroids (same as below)
+		for (size_t i = 0; i < initial_clusters.size(); ++i)
+		{
+			if (seed_adjacency.degree(i) < 6)
+				cluster_indices.push_back(i);
+		}
+
+		progress::shared_reporter().set(initial_clusters.size());
+
+		return cluster_indices;
+	}
+
+	point_subset<float> centroids(cloud);
+	centroids.indices.reserve(initial_clusters.size());
+
+	for (const cluster& init_cluster : initial_clusters)
+		centroids.indices.push_back(init_cluster[0]);
+
+	subset_tree centroid_tree(point::dimension, centroids, KDTreeSingleIndexAdaptorParams(10));
+	centroid_tree.buildIndex();
+
+	vector<char> is_boundary(initial_clusters.size());
+
+	parallel::for_each_chunk(0, initial_clusters.size(), 1024, [&](const size_t begin, const size_t end)
+	{
+		if (cancellation::shared_token().is_cancelled()) // clusters left undecided are not boundary
+			return;
+
+		arena::scope chunk_memory; // buffers of searcher and batches
+		batch_search::searcher<subset_tree> searcher(centroid_tree);
+
+		for (size_t i = begin; i < end; i += batch_search::default_batch_size)
+			detect_boundary_clusters(centroid_tree.vind.data() + i, min(batch_search::default_batch_size, end - i), searcher, is_boundary);
+
+		progress::shared_reporter().advance(end - begin);
+	});
+
+	for (size_t i = 0; i < is_boundary.size(); ++i)
+	{
+		if (is_boundary[i])
+			cluster_indices.push_back(i);
+	}
+
+	return cluster_indices;
+}
+
+/** @brief Divides boundary cluster until distance of every member to centroid of its cluster is at most half of Space Interval Threshold (DT),
+ *	so boundaries are kept with finer detail. Cluster is split by k-means with its centroid and its farthest member as means.
+*/
+template <typename Cluster>
+void recursive_boundary_subdivision(const Cluster& init_cluster, arena::vector<transient_cluster>& divided_clusters)
+{
+	const float max_distance = space_interval_dt / 2;
+
+	point_index farthest_index = 0;
+	double farthest_distance = 0;
+
+	for (size_t i = 1; i < init_cluster.size(); ++i)
+	{
+		const double distance = cloud.points[init_cluster[i]].distance(cloud.points[init_cluster[0]]);
+
+		if (distance > farthest_distance)
+		{
+			farthest_distance = distance;
+			farthest_index = static_cast<point_index>(i);
+		}
+	}
+
+	if (farthest_distance <= max_distance)
+	{
+		divided_clusters.emplace_back(init_cluster.begin(), init_cluster.end());
+		return;
+	}
+
+	const pair<transient_cluster, transient_cluster> halves = k_means_clustering(init_cluster, { 0, farthest_index });
+
+	cloud.points[init_cluster[farthest_index]].is_centroid = true;
+
+	recursive_boundary_subdivision(halves.first, divided_clusters);
+	recursive_boundary_subdivision(halves.second, divided_clusters);
+}
+
+/** @brief Divides boundary clusters in parallel. Each boundary cluster is replaced by first of its parts and other parts are added to initial_clusters.
+ *	Parts are collected in arena and copied once into clusters which are kept. Clusters are kept as they are if run is cancelled.
+*/
+void boundary_cluster_subdivision(const vector<size_t>& boundary_clusters)
+{
+	progress::shared_reporter().begin_stage("boundary_subdivision", boundary_clusters.size(), "clusters");
+
+	cout << "Dividing boundary clusters." << endl;
+
+	vector<vector<cluster>> divided_clusters(boundary_clusters.size());
+	cancellation::shared_token().reserve(export_seconds(initial_clusters.size())); // at least all initial clusters are exported
+
+	parallel::for_each_chunk(0, boundary_clusters.size(), 256, [&](const size_t begin, const size_t end)
+	{
+		if (cancellation::shared_token().is_cancelled())
+			return;
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			arena::scope cluster_memory; // parts of cluster which are not kept
+			arena::vector<transient_cluster> parts;
+
+			recursive_boundary_subdivision(initial_clusters[boundary_clusters[i]], parts);
+
+			// first part is not larger than divided cluster, so it replaces it without new allocation
+			initial_clusters[boundary_clusters[i]].assign(parts[0].begin(), parts[0].end());
+			divided_clusters[i].reserve(parts.size() - 1);
+
+			for (size_t j = 1; j < parts.size(); ++j)
+				divided_clusters[i].emplace_back(parts[j].begin(), parts[j].end());
+		}
+
+		progress::shared_reporter().advance(end - begin);
+	});
+
+	for (vector<cluster>& other_parts : divided_clusters) // empty if cluster was not divided (also if run was cancelled)
+	{
+		for (cluster& part : other_parts)
+			initial_clusters.push_back(move(part));
+	}
+}
+
+/** @brief Mean of members of cluster: mean position, mean color (rounded, as colors are exported as uchar) and renormalized mean normal vector.
+ *	Members are accumulated relative to centroid in single 9-element loop, so sums stay small and loop is vectorized by compiler.
+*/
+template <typename Cluster>
+point cluster_mean(const Cluster& members)
+{
+	const float* centroid = cloud.points[members[0]].data; // index to centroid is at index 0 in cluster
+	float sum[9]{};
+
+	for (const point_index member : members)
+	{
+		const float* data = cloud.points[member].data;
+
+		for (size_t k = 0; k < 9; ++k)
+			sum[k] += data[k] - centroid[k];
+	}
+
+	float mean[9];
+	const float scale = 1.0f / members.size();
+
+	for (size_t k = 0; k < 9; ++k)
+		mean[k] = centroid[k] + sum[k] * scale;
+
+	for (size_t k = 3; k < 6; ++k)
+		mean[k] = std::round(mean[k]);
+
+	const float length = std::sqrt(mean[6] * mean[6] + mean[7] * mean[7] + mean[8] * mean[8]);
+
+	for (size_t k = 6; k < 9; ++k)
+		mean[k] = length > 0 ? mean[k] / length : centroid[k]; // opposite normal vectors keep normal vector of centroid
+
+	return point(mean);
+}
+
+/** @brief Adds cluster to new_clusters (and its mean to representatives if means are exported instead of centroids).
+*/
+template <typename Cluster>
+void add_new_cluster(const Cluster& new_cluster)
+{
+	new_clusters.emplace_back(new_cluster.begin(), new_cluster.end());
+
+	if (mean_representatives)
+		representatives.push_back(cluster_mean(new_cluster));
+}
+
+/** @brief Decides whether cluster should be divided. If yes, it is recursively divided using k-means. If no, it is added to new_clusters.
+ *	Depth is number of divisions which led to this cluster.
+*/
+template <typename Cluster>
+void recursive_cluster_subdivision(const Cluster& init_cluster, const size_t depth = 0)
+{
+	const pair<point_index, point_index> means = new_means(init_cluster);
+
+	if (statistics.enabled && init_cluster.size() > 1 && vector_deviation_nt <= 0.99999)
+		statistics.deviation_evaluations += init_cluster.size() * (init_cluster.size() - 1) / 2;
+
+	if (means == no_division) // cluster should not be divided anymore
+	{
+		add_new_cluster(init_cluster);
+
+		if (statistics.enabled)
+			statistics.add_final_cluster(init_cluster.size(), depth);
+	}
+	else // recursively divide cluster
+	{
+		const pair<transient_cluster, transient_cluster> divided_clusters = k_means_clustering(init_cluster, means);
+
+		// means became new centroids for new clusters
+		cloud.points[init_cluster[0]].is_centroid = false;
+		cloud.points[init_cluster[means.first]].is_centroid = true;
+		cloud.points[init_cluster[means.second]].is_centroid = true;
+
+		// recursion
+		recursive_cluster_subdivision(divided_clusters.first, depth + 1);
+		recursive_cluster_subdivision(divided_clusters.second, depth + 1);
+	}
+}
+
+/** @brief Calls subdivision on all clusters. If run is cancelled, remaining initial clusters are added to new_clusters without subdivision,
+ *	so their centroids are exported as best available result.
+*/
+void main_cluster_subdivision()
+{
+	progress::reporter& stage_progress = progress::shared_reporter();
+	stage_progress.begin_stage("subdivision", initial_clusters.size(), "clusters");
+
+	cout << "Dividing clusters." << endl;
+
+	earliest_finish = chrono::steady_clock::time_point::max();
+	size_t i = 0;
+
+	for (; i < initial_clusters.size(); ++i)
+	{
+		stage_progress.set(i);
+
+		if (i % 64 == 0 && is_cancelled_before_export(new_clusters.size() + initial_clusters.size() - i)) // clusters left now would be exported undivided
+			break;
+
+		arena::scope cluster_memory; // parts of cluster which are not kept
+
+		if (!statistics.enabled)
+		{
+			recursive_cluster_subdivision(initial_clusters[i]);
+			continue;
+		}
+
+		const auto start = chrono::steady_clock::now();
+		recursive_cluster_subdivision(initial_clusters[i]);
+		statistics.add_initial_cluster(initial_clusters[i].size(), chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+
+	if (i < initial_clusters.size())
+	{
+		cout << "Run was cancelled; " << initial_clusters.size() - i << " clusters were left without subdivision." << endl;
+
+		for (; i < initial_clusters.size(); ++i)
+			add_new_cluster(initial_clusters[i]);
+	}
+
+	stage_progress.set(initial_clusters.size());
+}
+
+/** @brief Exports centroid (or mean, see representatives) from new_clusters. Exported file has same header and format as input file.
+ *	Export is not cancelled by time budget; stages before it keep time for it at end of budget (see is_cancelled_before_export).
+*/
+void export_point_cloud(const string& output_file_name)
+{
+	ofstream output_file(output_file_name);
+
+	progress::reporter& stage_progress = progress::shared_reporter();
+	stage_progress.begin_stage("export", new_clusters.size(), "points");
+
+	cout << "Exporting reduced point cloud to file: " + output_file_name << endl;
+
+	const bool has_origin = has_local_origin();
+	const string coordinate_type = has_origin ? "double" : "float";
+
+	// write header
+	output_file << "ply"<< endl << "format ascii 1.0" << endl << "element vertex " << new_clusters.size() << endl;
+	output_file << "property " << coordinate_type << " x" << endl << "property " << coordinate_type << " y" << endl << "property " << coordinate_type << " z" << endl;
+	output_file << "property uchar red" << endl << "property uchar green" << endl << "property uchar blue" << endl;
+	output_file << "property float nx" << endl << "property float ny" << endl << "property float nz" << endl;
+	output_file << "end_header" << endl;
+
+	stringstream line_stream; // for simple buffering (reused by all lines, so its buffer is allocated only once)
+
+	for (size_t i = 0; i < new_clusters.size(); ++i)
+	{
+		stage_progress.set(i);
+
+		const point& representative = mean_representatives ? representatives[i] : cloud.points[new_clusters[i][0]];
+		line_stream.str(string());
+
+		write_point(line_stream, representative, has_origin);
+
+		output_file << line_stream.rdbuf() << endl;
+	}
+
+	stage_progress.set(new_clusters.size());
+
+	cout << endl << endl << "Point cloud was reduced from " << cloud.points.size() << " points to " << new_clusters.size() << " points." << endl;
+	cout << "That is " << new_clusters.size() / static_cast<float>(cloud.points.size()) * 100 << "%.";
+}
+
+/** @brief Exports centroids from new_clusters as octree tiles for streaming: binary file with points of all nodes
+ *	and index file describing nodes (see octree). Node keeps at most max_node_points points.
+*/
+void export_octree(const string& binary_file_name, const string& index_file_name, const size_t max_node_points)
+{
+	progress::shared_reporter().begin_stage("octree_export", new_clusters.size(), "points");
+
+	cout << endl << "Exporting octree tiles to files: " + binary_file_name + ", " + index_file_name << endl;
+
+	octree tiles;
+
+	if (mean_representatives)
+	{
+		point_cloud<float> means;
+		means.points = representatives;
+		copy(cloud.origin, cloud.origin + 3, means.origin);
+
+		vector<point_index> indices(representatives.size());
+		iota(indices.begin(), indices.end(), point_index(0));
+
+		tiles.build(means, indices, max_node_points);
+		tiles.write(means, binary_file_name, index_file_name);
+	}
+	else
+	{
+		vector<point_index> centroids;
+		centroids.reserve(new_clusters.size());
+
+		for (const cluster& new_cluster : new_clusters)
+			centroids.push_back(new_cluster[0]); // index to centroid is at index 0 in cluster
+
+		tiles.build(cloud, centroids, max_node_points);
+		tiles.write(cloud, binary_file_name, index_file_name);
+	}
+
+	progress::shared_reporter().set(new_clusters.size());
+
+	cout << "Octree has " << tiles.nodes.size() << " nodes." << endl;
+}
+
+/** @brief Clears point cloud and all clusters, so another point cloud can be optimized in same process.
+*/
+void reset_optimizer()
+{
+	cloud = point_cloud<float>();
+	initial_clusters.clear();
+	new_clusters.clear();
+	representatives.clear();
+	original_indices.clear();
+	seed_adjacency.clear();
+	statistics.clear();
+}
@@ -0,0 +1,74 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+#include "nanoflann.hpp"
+#include "point.hpp"
+#include "point_cloud.hpp"
+#include "point_cloud_reader.hpp"
+#include "point_subset.hpp"
+#include "seed_graph.hpp"
+#include "subdivision_statistics.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+/** @brief Stages of point cloud optimization (import, clustering, subdivision and export) shared by command line tool and benchmark.
+ *	Stages work with global point cloud and clusters below and are expected to be called in order in which they are declared.
+*/
+
+typedef std::vector<point_index> cluster;
+typedef nanoflann::KDTreeSingleIndexAdaptor <nanoflann::L2_Simple_Adaptor<float, point_cloud<float> >, point_cloud<float>, point::dimension, point_index> tree; // K-D tree holding indices from "points" vector
+typedef nanoflann::KDTreeSingleIndexAdaptor <nanoflann::L2_Simple_Adaptor<float, point_subset<float> >, point_subset<float>, point::dimension, point_index> subset_tree; // K-D tree holding indices to subset of "points" vector (e.g. centroids only)
+
+extern point_cloud<float> cloud; // point cloud itself holding actual data to points
+extern std::vector<cluster> initial_clusters; // cluster holds indices to its members (index 0 refers to cluster centroid)
+extern std::vector<cluster> new_clusters; // used as final storage of clusters after subdivision of initial clusters
+extern std::vector<point> representatives; // means of new_clusters (same order), filled only if mean_representatives is set
+extern std::vector<point_index> original_indices; // original_indices[i] is index of point i in imported cloud, filled only if leaf_order is set
+extern seed_graph seed_adjacency; // centroids of initial_clusters (same order, clusters added by boundary subdivision are not included)
+                                  // within sqrt(3) * DT of each other, recorded only if record_seed_graph is set
+
+// Space Interval Threshold (DT) - largest distance from cluster centroid to any cluster member
+extern float space_interval_dt;
+
+// Normal Vector Deviation Threshold (NT) - largest deviation of normal vectors of any pair of cluster members (otherwise cluster is divided)
+extern float vector_deviation_nt;
+
+const std::string file_name_extention(".ply");
+const std::string las_file_name_extention(".las");
+const std::string cache_file_name_extention(".pcc");
+const std::string octree_file_name_extention(".octree.bin");
+const std::string octree_index_file_name_extention(".octree.json");
+
+// options of stages (set by optional switches of command line tool)
+extern bool use_cache; // --cache: read point cloud from native cache next to input file, create cache if it is missing or outdated
+extern bool morton_order; // --morton: reorder points along Morton (Z-order) curve after import (also stored in cache)
+extern bool leaf_order; // --leaf-order: reorder points to order of leaves of K-D tree after it is built, so every leaf is continuous block of points
+extern bool use_claim_index; // --claim-index: search neighbours in cluster initialization by K-D tree which skips points already in clusters
+                             // (its leaves are tested by SIMD kernel, --leaf-kernel=scalar|avx2|avx512 overrides kernel selected by processor)
+extern bool use_implicit_tree; // --implicit-tree: search neighbours in cluster initialization by pointer-free K-D tree with 32-bit indices
+extern bool mean_representatives; // --representative=mean: export mean of cluster members instead of its centroid (--representative=seed)
+extern size_t normal_neighbours; // --normal-k=N: number of nearest neighbours used to estimate normal vectors of clouds without them
+extern bool has_viewpoint; // --viewpoint=x,y,z: estimated normal vectors point towards this position (e.g. scanner), otherwise upwards
+extern double viewpoint[3];
+extern bool record_seed_graph; // set with --boundary: cluster initialization records seed_adjacency, so boundary detection needs no K-D tree queries
+
+extern subdivision_statistics statistics; // --stats: collected by main_cluster_subdivision and exported with run report (--report), one entry per level of detail with --lod
+
+std::string file_extention(const std::string& file_name);
+bool is_supported_file(const std::string& file_name);
+std::unique_ptr<point_cloud_reader> create_reader(const std::string& file_name);
+
+void import_point_cloud(const std::string& file_name);
+void leaf_order_stage(tree& my_tree);
+float space_interval_search_stage(const tree& my_tree, size_t target_points);
+void normal_estimation_stage(const tree& my_tree);
+void cluster_initialization(const tree& my_tree);
+void level_of_detail_initialization();
+std::vector<size_t> boundary_cluster_detection();
+void boundary_cluster_subdivision(const std::vector<size_t>& boundary_clusters);
+void main_cluster_subdivision();
+void export_point_cloud(const std::string& output_file_name);
+void export_octree(const std::string& binary_file_name, const std::string& index_file_name, size_t max_node_points);
+
+void reset_optimizer();
+#endif // OPTIMIZER_HPP
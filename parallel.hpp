@@ -0,0 +1,83 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel
+{
+	/** @brief Number of worker threads used by parallel stages (number of hardware threads by default).
+	*/
+	inline size_t& thread_count()
+	{
+		static size_t count = std::max<size_t>(1, std::thread::hardware_concurrency());
+		return count;
+	}
+
+	/** @brief Calls function(chunk_begin, chunk_end) for consecutive chunks of range [begin, end) on all worker threads.
+	 *	Chunks of grain size are handed out dynamically, so uneven work per chunk is balanced between threads.
+	 *	First exception thrown by function is rethrown in calling thread after all workers finished.
+	*/
+	template <typename Function>
+	void for_each_chunk(const size_t begin, const size_t end, const size_t grain, const Function& function)
+	{
+		if (begin >= end)
+			return;
+
+		const size_t chunk_size = std::max<size_t>(1, grain);
+		const size_t number_of_chunks = (end - begin + chunk_size - 1) / chunk_size;
+		const size_t number_of_threads = std::min(thread_count(), number_of_chunks);
+
+		if (number_of_threads <= 1)
+		{
+			for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += chunk_size) // chunks are kept, so function may report progress per chunk
+				function(chunk_begin, std::min(end, chunk_begin + chunk_size));
+
+			return;
+		}
+
+		std::atomic<size_t> next_chunk(0);
+		std::exception_ptr first_exception;
+		std::mutex exception_mutex;
+
+		auto worker = [&]()
+		{
+			try
+			{
+				for (size_t chunk = next_chunk++; chunk < number_of_chunks; chunk = next_chunk++)
+				{
+					const size_t chunk_begin = begin + chunk * chunk_size;
+					function(chunk_begin, std::min(end, chunk_begin + chunk_size));
+				}
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(exception_mutex);
+
+				if (!first_exception)
+					first_exception = std::current_exception();
+
+				next_chunk = number_of_chunks; // stop other workers
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(number_of_threads - 1);
+
+		for (size_t i = 1; i < number_of_threads; ++i)
+			threads.emplace_back(worker);
+
+		worker(); // calling thread works too
+
+		for (std::thread& thread : threads)
+			thread.join();
+
+		if (first_exception)
+			std::rethrow_exception(first_exception);
+	}
+}
+#endif // PARALLEL_HPP
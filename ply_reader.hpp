@@ -0,0 +1,192 @@
+#ifndef PLY_READER_HPP
+#define PLY_READER_HPP
+#include "cancellation.hpp"
+#include "memory_placement.hpp"
+#include "point_cloud_reader.hpp"
+#include "progress.hpp"
+#include "rply.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+/** @brief Reads vertices from ASCII or binary .ply file into point cloud. Properties of "vertex" element are mapped to point fields
+ *	by their names found in header, so their order does not matter. Properties which are not known are skipped by RPly without callback.
+ *
+ *	Coordinates x/y/z are mandatory. Colors (red/green/blue) and normal vectors (nx/ny/nz) are optional and are filled with zeros when missing.
+ *	Coordinates stored as double are shifted by origin of point cloud so they keep their precision in float.
+*/
+class ply_reader : public point_cloud_reader
+{
+public:
+	void read(const std::string& file_name, point_cloud<float>& cloud) override
+	{
+		target = &cloud;
+		file_size = static_cast<uint64_t>(std::ifstream(file_name, std::ios::binary | std::ios::ate).tellg());
+
+		const p_ply ply = ply_open(file_name.c_str(), nullptr, 0, nullptr);
+
+		if (!ply)
+			throw std::runtime_error("Could not open file " + file_name);
+
+		try
+		{
+			read_ply(ply);
+		}
+		catch (...)
+		{
+			ply_close(ply);
+			throw;
+		}
+
+		ply_close(ply);
+	}
+
+private:
+	static const int field_count = 9;
+
+	point_cloud<float>* target = nullptr;
+
+	double buffer[field_count]{};
+	long last_field = -1; // field whose callback completes one vertex (last mapped property in header)
+	bool double_coordinates = false;
+	bool origin_is_set = false;
+
+	// progress of import is reported in bytes; position in file is estimated from number of read vertices
+	uint64_t file_size = 0;
+	long number_of_vertices = 0;
+	long vertices_read = 0;
+
+	/** @brief Returns index to point::data for given property name or -1 if property is not known.
+	*/
+	static int field_for_property(const char* name)
+	{
+		static const char* const names[][field_count] =
+		{
+			{ "x", "y", "z", "red", "green", "blue", "nx", "ny", "nz" },
+			{ "x", "y", "z", "r", "g", "b", "normal_x", "normal_y", "normal_z" },
+			{ "x", "y", "z", "diffuse_red", "diffuse_green", "diffuse_blue", "nx", "ny", "nz" }
+		};
+
+		for (const auto& alias : names)
+		{
+			for (int i = 0; i < field_count; ++i)
+			{
+				if (std::strcmp(alias[i], name) == 0)
+					return i;
+			}
+		}
+
+		return -1;
+	}
+
+	void read_ply(const p_ply ply)
+	{
+		if (!ply_read_header(ply))
+			throw std::runtime_error("Invalid .ply header");
+
+		p_ply_element vertex_element = nullptr;
+
+		for (p_ply_element element = ply_get_next_element(ply, nullptr); element; element = ply_get_next_element(ply, element))
+		{
+			const char* element_name;
+			long instances;
+			ply_get_element_info(element, &element_name, &instances);
+
+			if (std::strcmp(element_name, "vertex") == 0)
+			{
+				vertex_element = element;
+				number_of_vertices = instances;
+				break;
+			}
+		}
+
+		if (!vertex_element)
+			throw std::runtime_error("File does not contain vertex element");
+
+		bool mapped[field_count]{};
+
+		for (p_ply_property property = ply_get_next_property(vertex_element, nullptr); property; property = ply_get_next_property(vertex_element, property))
+		{
+			const char* property_name;
+			e_ply_type type;
+			ply_get_property_info(property, &property_name, &type, nullptr, nullptr);
+
+			const int field = field_for_property(property_name);
+
+			if (field < 0 || mapped[field] || type == PLY_LIST) // unknown properties have no callback and RPly only steps over them
+				continue;
+
+			mapped[field] = true;
+			last_field = field;
+
+			if (field < 3 && (type == PLY_FLOAT64 || type == PLY_DOUBLE))
+				double_coordinates = true;
+
+			ply_set_read_cb(ply, "vertex", property_name, property_cb, this, field);
+		}
+
+		if (!mapped[0] || !mapped[1] || !mapped[2])
+			throw std::runtime_error("Vertex element does not contain x, y and z properties");
+
+		target->has_colors = mapped[3] && mapped[4] && mapped[5];
+		target->has_normals = mapped[6] && mapped[7] && mapped[8];
+
+		memory_placement::reserve(target->points, target->points.size() + number_of_vertices);
+
+		if (!ply_read(ply))
+		{
+			cancellation::shared_token().throw_if_cancelled();
+			throw std::runtime_error("Could not parse .ply data");
+		}
+	}
+
+	/** @brief Callback for parse. This method is called for every mapped property of every vertex.
+	*/
+	static int property_cb(const p_ply_argument argument)
+	{
+		void* user_data;
+		long field;
+		ply_get_argument_user_data(argument, &user_data, &field);
+
+		ply_reader& reader = *static_cast<ply_reader*>(user_data);
+		reader.buffer[field] = ply_get_argument_value(argument);
+
+		if (field == reader.last_field)
+		{
+			reader.emit_point();
+
+			if (reader.vertices_read % 65536 == 0 && cancellation::shared_token().is_cancelled())
+				return 0; // aborts parsing; exception must not be thrown through RPly
+		}
+
+		return 1;
+	}
+
+	void emit_point()
+	{
+		if (double_coordinates && !origin_is_set)
+		{
+			// large (e.g. geo-referenced) coordinates would lose precision in float; first point defines local origin
+			for (int i = 0; i < 3; ++i)
+				target->origin[i] = std::floor(buffer[i]);
+
+			origin_is_set = true;
+		}
+
+		float values[field_count];
+
+		for (int i = 0; i < 3; ++i)
+			values[i] = static_cast<float>(buffer[i] - target->origin[i]);
+
+		for (int i = 3; i < field_count; ++i)
+			values[i] = static_cast<float>(buffer[i]);
+
+		target->add_point(values);
+
+		if (++vertices_read % 65536 == 0 && number_of_vertices > 0)
+			progress::shared_reporter().set(file_size * vertices_read / number_of_vertices);
+	}
+};
+#endif // PLY_READER_HPP
@@ -1,4 +1,5 @@
 ﻿#pragma once
+#include <cmath>
 
 /** @brief Data class holding info for 1 point from point cloud. Data is stored in array for easier iterative access.
 */
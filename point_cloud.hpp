@@ -1,8 +1,17 @@
 #ifndef POINT_CLOUD_HPP
 #define POINT_CLOUD_HPP
 #include "point.hpp"
+#include <cstdint>
 #include <vector>
 
+// index to points of cloud used by K-D trees, clusters and search results; 32 bits halve memory of index structures,
+// builds with POCO_INDEX_64 defined support clouds with more than 2^32 - 1 points
+#ifdef POCO_INDEX_64
+typedef uint64_t point_index;
+#else
+typedef uint32_t point_index;
+#endif
+
 /** @brief Data class containing vector of actual points. Other data structures holds indices to this vector.
 */
 template <typename T>
@@ -10,6 +19,58 @@ struct point_cloud
 {
 	std::vector<point> points; // points of point cloud themselves (there are expected to be millions of points == tens of millions of bytes)
 
+	double origin[3]{}; // offset added to point coordinates on export (non-zero only for clouds imported with large double coordinates)
+
+	bool has_colors = true; // false if source file does not contain colors (they are zero)
+	bool has_normals = true; // false if source file does not contain normal vectors (they are zero)
+
+	// axis-aligned bounding box of all points, valid only if has_bounds is set (all points were appended by add_point or compute_bounds was called)
+	bool has_bounds = false;
+	float bounds_min[3]{};
+	float bounds_max[3]{};
+
+	/** @brief Appends point (coordinates, color, normal vector) and extends bounding box by it, so bounding box is known without another pass over points.
+	*/
+	void add_point(const float values[9])
+	{
+		points.emplace_back(values);
+
+		if (points.size() == 1)
+		{
+			for (int d = 0; d < 3; ++d)
+				bounds_min[d] = bounds_max[d] = values[d];
+
+			has_bounds = true;
+		}
+		else if (has_bounds)
+		{
+			for (int d = 0; d < 3; ++d)
+			{
+				bounds_min[d] = values[d] < bounds_min[d] ? values[d] : bounds_min[d];
+				bounds_max[d] = values[d] > bounds_max[d] ? values[d] : bounds_max[d];
+			}
+		}
+	}
+
+	/** @brief Computes bounding box by pass over all points (for points which were not appended by add_point).
+	*/
+	void compute_bounds()
+	{
+		has_bounds = false;
+
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			for (int d = 0; d < 3; ++d)
+			{
+				const float value = points[i].data[d];
+				bounds_min[d] = i == 0 || value < bounds_min[d] ? value : bounds_min[d];
+				bounds_max[d] = i == 0 || value > bounds_max[d] ? value : bounds_max[d];
+			}
+		}
+
+		has_bounds = !points.empty();
+	}
+
 	// Must return the number of data points
 	size_t kdtree_get_point_count() const
 	{
@@ -27,10 +88,20 @@ struct point_cloud
 	// Optional bounding-box computation: return false to default to a standard bbox computation loop.
 	//   Return true if the BBOX was already computed by the class and returned in "bb" so it can be avoided to redo it again.
 	//   Look at bb.size() to find out the expected dimensionality (e.g. 2 or 3 for point clouds)
+	// Bounding box tracked during import is returned, so K-D tree build does not need extra pass over all points.
 	template <class BBOX>
-	bool kdtree_get_bbox(BBOX& /* bb */) const
+	bool kdtree_get_bbox(BBOX& bb) const
 	{
-		return false;
+		if (!has_bounds)
+			return false;
+
+		for (int d = 0; d < 3; ++d)
+		{
+			bb[d].low = bounds_min[d];
+			bb[d].high = bounds_max[d];
+		}
+
+		return true;
 	}
 
 };
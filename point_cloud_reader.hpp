@@ -0,0 +1,17 @@
+#ifndef POINT_CLOUD_READER_HPP
+#define POINT_CLOUD_READER_HPP
+#include "point_cloud.hpp"
+#include <string>
+
+/** @brief Interface of readers of point cloud file formats. Reader appends points from file to point cloud
+ *	and sets has_colors/has_normals (and origin, if needed) according to data found in file.
+ *	Reader throws std::exception (with description in what()) if file could not be read.
+*/
+class point_cloud_reader
+{
+public:
+	virtual ~point_cloud_reader() = default;
+
+	virtual void read(const std::string& file_name, point_cloud<float>& cloud) = 0;
+};
+#endif // POINT_CLOUD_READER_HPP
@@ -0,0 +1,38 @@
+#ifndef POINT_SUBSET_HPP
+#define POINT_SUBSET_HPP
+#include "point_cloud.hpp"
+#include <vector>
+
+/** @brief Data class exposing subset of points of point cloud (given by indices to its "points" vector) to K-D tree.
+ *	Indices returned by K-D tree built over subset are indices to "indices" vector, not to point cloud.
+*/
+template <typename T>
+struct point_subset
+{
+	const point_cloud<T>& cloud;
+	std::vector<point_index> indices; // indices to points of cloud which are members of subset
+
+	explicit point_subset(const point_cloud<T>& source_cloud) : cloud(source_cloud)
+	{
+	}
+
+	// Must return the number of data points
+	size_t kdtree_get_point_count() const
+	{
+		return indices.size();
+	}
+
+	// Returns the dim'th component of the idx'th point in the subset
+	T kdtree_get_pt(const size_t idx, const size_t dim) const
+	{
+		return cloud.points[indices[idx]].data[dim];
+	}
+
+	// Bounding box is computed by K-D tree itself
+	template <class BBOX>
+	bool kdtree_get_bbox(BBOX& /* bb */) const
+	{
+		return false;
+	}
+};
+#endif // POINT_SUBSET_HPP
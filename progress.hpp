@@ -0,0 +1,195 @@
+#ifndef PROGRESS_HPP
+#define PROGRESS_HPP
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/** @brief Progress of long-running stages with rate and estimated time of arrival (ETA).
+ *	Stages only store amount of processed work to relaxed atomic counter, so reporting costs almost nothing when it is disabled
+ *	and does not slow down hot loops when it is enabled. Background thread samples counters in regular intervals and prints them.
+*/
+namespace progress
+{
+	class reporter
+	{
+	public:
+		~reporter()
+		{
+			stop();
+		}
+
+		/** @brief Starts background thread which prints progress to console (if enabled) and rewrites progress file (if file name is not empty)
+		 *	every interval. Progress file holds single JSON object, so it can be polled by job monitoring.
+		*/
+		void start(const bool to_console, const std::string& file_name, const double interval_seconds = 1)
+		{
+			stop();
+
+			console = to_console;
+			progress_file_name = file_name;
+			interval = std::chrono::duration<double>(interval_seconds);
+			running = true;
+			sampler = std::thread(&reporter::sample_loop, this);
+		}
+
+		/** @brief Stops background thread; last state of progress is printed and written before it ends.
+		*/
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (!running)
+					return;
+
+				running = false;
+			}
+
+			wake_up.notify_all();
+			sampler.join();
+		}
+
+		/** @brief Begins new stage with known amount of work (total) in given units (e.g. "bytes", "points"). Total may be 0 if it is not known.
+		 *	Progress line of previous stage is cleared, so messages of new stage can be printed after this call.
+		*/
+		void begin_stage(const std::string& name, const uint64_t total, const std::string& unit)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			clear_line();
+
+			stage_name = name;
+			stage_unit = unit;
+			stage_start = std::chrono::steady_clock::now();
+			total_work.store(total, std::memory_order_relaxed);
+			done_work.store(0, std::memory_order_relaxed);
+		}
+
+		/** @brief Adds processed work of current stage. May be called from multiple threads.
+		*/
+		void advance(const uint64_t amount)
+		{
+			done_work.fetch_add(amount, std::memory_order_relaxed);
+		}
+
+		/** @brief Sets processed work of current stage. Intended for single-threaded loops.
+		*/
+		void set(const uint64_t amount)
+		{
+			done_work.store(amount, std::memory_order_relaxed);
+		}
+
+		void set_total(const uint64_t total)
+		{
+			total_work.store(total, std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<uint64_t> done_work{ 0 };
+		std::atomic<uint64_t> total_work{ 0 };
+
+		std::mutex mutex; // guards stage description and running flag
+		std::condition_variable wake_up;
+		std::string stage_name;
+		std::string stage_unit;
+		std::chrono::steady_clock::time_point stage_start = std::chrono::steady_clock::now();
+
+		bool running = false;
+		bool console = false;
+		std::string progress_file_name;
+		std::chrono::duration<double> interval{ 1 };
+		std::thread sampler;
+		size_t line_length = 0; // length of progress line printed to console
+
+		void sample_loop()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			while (running)
+			{
+				wake_up.wait_for(lock, interval);
+				sample();
+			}
+
+			clear_line();
+		}
+
+		void clear_line()
+		{
+			if (line_length > 0)
+				std::cerr << '\r' << std::string(line_length, ' ') << '\r' << std::flush;
+
+			line_length = 0;
+		}
+
+		/** @brief Prints and writes current progress. Expects locked mutex.
+		*/
+		void sample()
+		{
+			if (stage_name.empty())
+				return;
+
+			const uint64_t done = done_work.load(std::memory_order_relaxed);
+			const uint64_t total = total_work.load(std::memory_order_relaxed);
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - stage_start).count();
+			const double rate = elapsed > 0 ? done / elapsed : 0;
+			const double eta = rate > 0 && total > done ? (total - done) / rate : 0; // 0 if not known
+
+			if (console)
+			{
+				std::ostringstream line;
+				line << std::fixed << std::setprecision(1) << '\r' << stage_name << ": ";
+
+				if (total > 0)
+					line << 100.0 * std::min(done, total) / total << "% (" << done << " / " << total << ' ' << stage_unit << ")";
+				else
+					line << done << ' ' << stage_unit;
+
+				line << ", " << std::setprecision(0) << rate << ' ' << stage_unit << "/s, elapsed " << format_time(elapsed);
+
+				if (eta > 0)
+					line << ", ETA " << format_time(eta);
+
+				const std::string text = line.str();
+
+				std::cerr << text << std::string(text.size() < line_length ? line_length - text.size() : 0, ' ') << std::flush; // overwrites rest of longer previous line
+				line_length = std::max(line_length, text.size());
+			}
+
+			if (!progress_file_name.empty())
+			{
+				std::ofstream progress_file(progress_file_name, std::ios::trunc);
+				progress_file << std::setprecision(9) << "{ \"stage\": \"" << stage_name << "\", \"unit\": \"" << stage_unit << "\", \"done\": " << done
+					<< ", \"total\": " << total << ", \"elapsed_seconds\": " << elapsed << ", \"rate\": " << rate << ", \"eta_seconds\": " << eta << " }\n";
+			}
+		}
+
+		static std::string format_time(const double seconds)
+		{
+			const uint64_t whole_seconds = static_cast<uint64_t>(seconds + 0.5);
+			std::ostringstream time;
+
+			time << std::setfill('0') << whole_seconds / 3600 << ':' << std::setw(2) << whole_seconds / 60 % 60 << ':' << std::setw(2) << whole_seconds % 60;
+
+			return time.str();
+		}
+	};
+
+	/** @brief Reporter shared by stages and readers of this process.
+	*/
+	inline reporter& shared_reporter()
+	{
+		static reporter instance;
+		return instance;
+	}
+}
+#endif // PROGRESS_HPP
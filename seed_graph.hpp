@@ -0,0 +1,183 @@
+#ifndef SEED_GRAPH_HPP
+#define SEED_GRAPH_HPP
+#include "point_cloud.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/** @brief Adjacency graph of cluster seeds (centroids of initial clusters): seeds are adjacent if their squared distance is less than squared radius.
+ *	Seeds are recorded by cluster initialization as they are created and graph is built when initialization finishes:
+ *	seeds are sorted to cells of grid (cell edge is radius) and only seeds in neighbouring cells are compared, so graph costs no K-D tree queries.
+ *	Squared distance is computed in same order as by L2_Simple_Adaptor of nanoflann, so graph has exactly same edges
+ *	as radius searches of K-D tree over seeds would find.
+ *	Finished graph is stored in compressed sparse row form: neighbours of seed i (in ascending order) are neighbours[offsets[i]] to neighbours[offsets[i + 1] - 1].
+*/
+class seed_graph
+{
+public:
+	/** @brief Starts recording of new graph of seeds with given squared radius (previous graph is cleared).
+	*/
+	void begin(const float squared_radius)
+	{
+		clear();
+		radius = squared_radius;
+	}
+
+	/** @brief Records seed at given position. Index of seed is number of seeds recorded before it.
+	*/
+	void add_seed(const float* position)
+	{
+		positions.insert(positions.end(), position, position + 3);
+	}
+
+	/** @brief Builds graph of recorded seeds.
+	*/
+	void finish()
+	{
+		const size_t n = positions.size() / 3;
+		const double cell_size = std::sqrt(static_cast<double>(radius)) * 1.001; // margin keeps neighbours in adjacent cells despite rounding
+
+		// seeds sorted by cell (cells in lexicographic order of their coordinates), so seeds of every cell are continuous
+		std::vector<grid_entry> entries(n);
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			for (int d = 0; d < 3; ++d)
+				entries[i].cell[d] = static_cast<int64_t>(std::floor(positions[3 * i + d] / cell_size));
+
+			entries[i].seed = static_cast<point_index>(i);
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const grid_entry& a, const grid_entry& b)
+		{
+			return cell_less(a.cell, b.cell) || (!cell_less(b.cell, a.cell) && a.seed < b.seed);
+		});
+
+		std::vector<size_t> cell_begin; // first entry of every cell (followed by n)
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (i == 0 || cell_less(entries[i - 1].cell, entries[i].cell))
+				cell_begin.push_back(i);
+		}
+
+		const size_t number_of_cells = cell_begin.size();
+		cell_begin.push_back(n);
+
+		// every pair of neighbouring cells is visited once from earlier cell; cells of each of 9 columns (dx, dy) around cell
+		// are found by cursor which only moves forward, because cell shifted by constant offset keeps lexicographic order
+		std::vector<std::pair<point_index, point_index>> edges;
+		size_t cursors[9]{};
+
+		for (size_t c = 0; c < number_of_cells; ++c)
+		{
+			const int64_t* cell = entries[cell_begin[c]].cell;
+
+			for (int column = 0; column < 9; ++column)
+			{
+				const int64_t first_cell[3] = { cell[0] + column / 3 - 1, cell[1] + column % 3 - 1, cell[2] - 1 };
+				const int64_t last_cell[3] = { first_cell[0], first_cell[1], cell[2] + 1 };
+				size_t& cursor = cursors[column];
+
+				while (cursor < number_of_cells && cell_less(entries[cell_begin[cursor]].cell, first_cell))
+					cursor++;
+
+				for (size_t other = std::max(cursor, c); other < number_of_cells && !cell_less(last_cell, entries[cell_begin[other]].cell); ++other)
+					connect(entries, cell_begin[c], cell_begin[c + 1], cell_begin[other], cell_begin[other + 1], other == c, edges);
+			}
+		}
+
+		offsets.assign(n + 1, 0);
+
+		for (const auto& edge : edges)
+		{
+			offsets[edge.first + 1]++;
+			offsets[edge.second + 1]++;
+		}
+
+		for (size_t i = 0; i < n; ++i)
+			offsets[i + 1] += offsets[i];
+
+		neighbours.resize(offsets[n]);
+		std::vector<size_t> filled(offsets.begin(), offsets.end() - 1);
+
+		for (const auto& edge : edges)
+		{
+			neighbours[filled[edge.first]++] = edge.second;
+			neighbours[filled[edge.second]++] = edge.first;
+		}
+
+		for (size_t i = 0; i < n; ++i)
+			std::sort(neighbours.begin() + offsets[i], neighbours.begin() + offsets[i + 1]);
+
+		std::vector<float>().swap(positions);
+		number_of_seeds = n;
+	}
+
+	void clear()
+	{
+		*this = seed_graph();
+	}
+
+	/** @brief Number of seeds of finished graph (0 if graph was not built).
+	*/
+	size_t size() const
+	{
+		return number_of_seeds;
+	}
+
+	size_t degree(const size_t seed) const
+	{
+		return offsets[seed + 1] - offsets[seed];
+	}
+
+	const point_index* neighbours_of(const size_t seed) const
+	{
+		return neighbours.data() + offsets[seed];
+	}
+
+private:
+	struct grid_entry
+	{
+		int64_t cell[3];
+		point_index seed;
+	};
+
+	float radius = 0; // squared radius
+	size_t number_of_seeds = 0;
+	std::vector<float> positions; // coordinates of recorded seeds (3 per seed)
+
+	std::vector<size_t> offsets;
+	std::vector<point_index> neighbours;
+
+	static bool cell_less(const int64_t* a, const int64_t* b)
+	{
+		return a[0] < b[0] || (a[0] == b[0] && (a[1] < b[1] || (a[1] == b[1] && a[2] < b[2])));
+	}
+
+	/** @brief Records edges between seeds of entries [first_begin, first_end) and [second_begin, second_end) (or between seeds of one cell).
+	*/
+	void connect(const std::vector<grid_entry>& entries, const size_t first_begin, const size_t first_end, const size_t second_begin, const size_t second_end,
+		const bool is_same_cell, std::vector<std::pair<point_index, point_index>>& edges) const
+	{
+		for (size_t i = first_begin; i < first_end; ++i)
+		{
+			const point_index seed = entries[i].seed;
+			const float* position = positions.data() + 3 * static_cast<size_t>(seed);
+
+			for (size_t j = is_same_cell ? i + 1 : second_begin; j < second_end; ++j)
+			{
+				const point_index other = entries[j].seed;
+				const float* other_position = positions.data() + 3 * static_cast<size_t>(other);
+				const float x = position[0] - other_position[0], y = position[1] - other_position[1], z = position[2] - other_position[2];
+
+				if (x * x + y * y + z * z < radius)
+					edges.emplace_back(seed, other);
+			}
+		}
+	}
+};
+#endif // SEED_GRAPH_HPP
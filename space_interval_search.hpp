@@ -0,0 +1,156 @@
+#ifndef SPACE_INTERVAL_SEARCH_HPP
+#define SPACE_INTERVAL_SEARCH_HPP
+#include "cancellation.hpp"
+#include "nanoflann.hpp"
+#include "point_cloud.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/** @brief Search of Space Interval Threshold (DT) which reduces point cloud to target number of points.
+ *	Number of clusters falls with DT roughly as power law (exponent is close to -2 for surfaces), so DT is searched by secant method
+ *	on logarithms of DT and of number of clusters. Cheap voxel count estimator brings DT close to target first
+ *	and greedy count of initial clusters with already built K-D tree corrects it in few passes.
+*/
+namespace space_interval_search
+{
+	// greedy initial clusters with DT are about as many as occupied voxels with edge 1.55 * DT (measured on sampled surfaces)
+	const float voxel_edge_per_space_interval = 1.55f;
+
+	/** @brief Largest extent of axis-aligned bounding box of cloud. Bounding box tracked during import is used if cloud has it.
+	*/
+	inline float largest_extent(const point_cloud<float>& cloud)
+	{
+		if (cloud.points.empty())
+			return 0;
+
+		float min[3], max[3];
+
+		for (int d = 0; d < 3; ++d)
+			min[d] = max[d] = cloud.points[0].data[d];
+
+		if (cloud.has_bounds)
+		{
+			std::copy(cloud.bounds_min, cloud.bounds_min + 3, min);
+			std::copy(cloud.bounds_max, cloud.bounds_max + 3, max);
+		}
+		else
+		{
+			for (const point& p : cloud.points)
+			{
+				for (int d = 0; d < 3; ++d)
+				{
+					min[d] = std::min(min[d], p.data[d]);
+					max[d] = std::max(max[d], p.data[d]);
+				}
+			}
+		}
+
+		return std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+	}
+
+	/** @brief Number of occupied cubic voxels with given edge. Voxel coordinates are packed to 21 bits per axis,
+	 *	which is exact for up to 2 million voxels along every axis.
+	*/
+	inline size_t count_occupied_voxels(const point_cloud<float>& cloud, const float edge)
+	{
+		std::vector<uint64_t> keys;
+		keys.reserve(cloud.points.size());
+
+		const uint64_t mask = (uint64_t(1) << 21) - 1;
+
+		for (const point& p : cloud.points)
+		{
+			uint64_t key = 0;
+
+			for (int d = 0; d < 3; ++d)
+				key = (key << 21) | (static_cast<uint64_t>(static_cast<int64_t>(std::floor(p.data[d] / edge))) & mask);
+
+			keys.push_back(key);
+		}
+
+		std::sort(keys.begin(), keys.end());
+
+		return static_cast<size_t>(std::unique(keys.begin(), keys.end()) - keys.begin());
+	}
+
+	/** @brief Number of initial clusters which cluster initialization would create for given DT. Nothing is stored to cloud.
+	 *	Points are visited as seeds in same order as by cluster initialization: seeds[k] is k-th visited point (import order if seeds is empty).
+	 *	Throws cancellation::cancelled_error if run is cancelled, because partial count would mislead search.
+	*/
+	template <typename Tree>
+	size_t count_initial_clusters(const point_cloud<float>& cloud, const Tree& tree, const float space_interval, const std::vector<point_index>& seeds)
+	{
+		cancellation::token& token = cancellation::shared_token();
+		std::vector<char> is_marked(cloud.points.size());
+		std::vector<std::pair<point_index, float>> indices_dists;
+		size_t count = 0;
+
+		for (size_t k = 0; k < cloud.points.size(); ++k)
+		{
+			if (k % 1024 == 0)
+				token.throw_if_cancelled();
+
+			const size_t i = seeds.empty() ? k : seeds[k];
+
+			if (is_marked[i])
+				continue;
+
+			tree.radiusSearch(cloud.points[i].data, space_interval * space_interval, indices_dists, nanoflann::SearchParams());
+
+			for (const std::pair<point_index, float>& found : indices_dists)
+				is_marked[found.first] = true;
+
+			count++;
+		}
+
+		return count;
+	}
+
+	/** @brief Searches argument of decreasing count function for which count is within relative tolerance from target.
+	 *	Starts at x and uses slope as estimate of d(log count) / d(log x) until two measurements are known.
+	 *	Returns argument with count closest to target; slope is updated with last measured one.
+	 *	Report(x, count) is called after every evaluation of count.
+	*/
+	template <typename Count, typename Report>
+	float secant_search(const Count& count, float x, const size_t target, const double tolerance, const size_t max_passes, double& slope, const Report& report)
+	{
+		const double log_target = std::log(static_cast<double>(target));
+
+		double log_x = std::log(x);
+		double log_count = std::log(std::max<double>(1, static_cast<double>(count(x))));
+		report(x, std::exp(log_count));
+
+		float best_x = x;
+		double best_error = std::fabs(log_count - log_target);
+
+		for (size_t pass = 1; pass < max_passes && best_error > std::log1p(tolerance); ++pass)
+		{
+			const double step = std::max(-std::log(10.0), std::min(std::log(10.0), (log_target - log_count) / slope)); // at most 10 times in one pass
+			const double next_log_x = log_x + step;
+
+			x = static_cast<float>(std::exp(next_log_x));
+			const double next_log_count = std::log(std::max<double>(1, static_cast<double>(count(x))));
+			report(x, std::exp(next_log_count));
+
+			const double measured_slope = (next_log_count - log_count) / (next_log_x - log_x);
+
+			if (std::isfinite(measured_slope) && measured_slope < -0.1) // flat parts of count (e.g. single voxel) would make step too large
+				slope = measured_slope;
+
+			log_x = next_log_x;
+			log_count = next_log_count;
+
+			if (std::fabs(log_count - log_target) < best_error)
+			{
+				best_error = std::fabs(log_count - log_target);
+				best_x = x;
+			}
+		}
+
+		return best_x;
+	}
+}
+#endif // SPACE_INTERVAL_SEARCH_HPP
@@ -0,0 +1,101 @@
+#ifndef SUBDIVISION_STATISTICS_HPP
+#define SUBDIVISION_STATISTICS_HPP
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/** @brief Optional statistics of cluster subdivision: histograms of cluster sizes and split depths, number of pairwise
+ *	normal vector deviation evaluations and time spent on initial clusters of each size. Sizes are grouped to power-of-two
+ *	buckets (bucket k holds sizes 2^k to 2^(k+1) - 1).
+*/
+class subdivision_statistics
+{
+public:
+	bool enabled = false;
+
+	std::vector<size_t> initial_cluster_sizes; // histogram of sizes of initial clusters
+	std::vector<size_t> final_cluster_sizes; // histogram of sizes of clusters after subdivision
+	std::vector<size_t> split_depths; // histogram of recursion depth at which final clusters were created (0 = not divided)
+	std::vector<double> seconds_per_size_bucket; // time spent on subdivision of initial clusters of each size bucket
+	unsigned long long deviation_evaluations = 0; // number of evaluated pairs in new_means
+
+	/** @brief Clears collected statistics (e.g. before next level of detail); enabled is kept.
+	*/
+	void clear()
+	{
+		const bool was_enabled = enabled;
+		*this = subdivision_statistics();
+		enabled = was_enabled;
+	}
+
+	static size_t size_bucket(size_t size)
+	{
+		size_t bucket = 0;
+
+		while (size >>= 1)
+			bucket++;
+
+		return bucket;
+	}
+
+	void add_initial_cluster(const size_t size, const double seconds)
+	{
+		increment(initial_cluster_sizes, size_bucket(size));
+
+		const size_t bucket = size_bucket(size);
+
+		if (seconds_per_size_bucket.size() <= bucket)
+			seconds_per_size_bucket.resize(bucket + 1);
+
+		seconds_per_size_bucket[bucket] += seconds;
+	}
+
+	void add_final_cluster(const size_t size, const size_t depth)
+	{
+		increment(final_cluster_sizes, size_bucket(size));
+		increment(split_depths, depth);
+	}
+
+	/** @brief Returns statistics as JSON object.
+	*/
+	std::string to_json() const
+	{
+		std::ostringstream json;
+		json.precision(9);
+
+		json << "{ \"deviation_evaluations\": " << deviation_evaluations << ", \"size_buckets\": [";
+
+		for (size_t i = 0; i < std::max(initial_cluster_sizes.size(), final_cluster_sizes.size()); ++i)
+		{
+			json << (i ? ", " : " ") << "{ \"min_size\": " << (size_t(1) << i) << ", \"max_size\": " << (size_t(2) << i) - 1
+				<< ", \"initial_clusters\": " << value_or_zero(initial_cluster_sizes, i) << ", \"final_clusters\": " << value_or_zero(final_cluster_sizes, i)
+				<< ", \"subdivision_seconds\": " << (i < seconds_per_size_bucket.size() ? seconds_per_size_bucket[i] : 0) << " }";
+		}
+
+		json << " ], \"split_depths\": [";
+
+		for (size_t i = 0; i < split_depths.size(); ++i)
+			json << (i ? ", " : " ") << split_depths[i];
+
+		json << " ] }";
+
+		return json.str();
+	}
+
+private:
+	static void increment(std::vector<size_t>& histogram, const size_t bucket)
+	{
+		if (histogram.size() <= bucket)
+			histogram.resize(bucket + 1);
+
+		histogram[bucket]++;
+	}
+
+	static size_t value_or_zero(const std::vector<size_t>& histogram, const size_t bucket)
+	{
+		return bucket < histogram.size() ? histogram[bucket] : 0;
+	}
+};
+#endif // SUBDIVISION_STATISTICS_HPP
@@ -0,0 +1,151 @@
+#ifndef SYNTHETIC_CLOUD_HPP
+#define SYNTHETIC_CLOUD_HPP
+#include "memory_placement.hpp"
+#include "point_cloud.hpp"
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+/** @brief Generators of synthetic point clouds with colors and unit normal vectors for benchmarking.
+ *	Every generator is deterministic for given number of points and seed. Clouds span roughly 100 x 100 units,
+ *	so same Space Interval Threshold (DT) gives comparable reduction for all of them.
+*/
+namespace synthetic_cloud
+{
+	const float extent = 100;
+
+	inline void add_point(point_cloud<float>& cloud, const float x, const float y, const float z, const float nx, const float ny, const float nz, std::mt19937_64& random)
+	{
+		const float color = static_cast<float>(random() % 256);
+		const float values[9] = { x, y, z, color, color, color, nx, ny, nz };
+		cloud.add_point(values);
+	}
+
+	/** @brief Uniformly sampled flat square in XY plane. All normal vectors are equal, so clusters are never divided by NT.
+	*/
+	inline void plane(point_cloud<float>& cloud, const size_t number_of_points, const uint64_t seed)
+	{
+		std::mt19937_64 random(seed);
+		std::uniform_real_distribution<float> coordinate(0, extent);
+
+		memory_placement::reserve(cloud.points, number_of_points);
+
+		for (size_t i = 0; i < number_of_points; ++i)
+		{
+			const float x = coordinate(random);
+			const float y = coordinate(random);
+			add_point(cloud, x, y, 0, 0, 0, 1, random);
+		}
+	}
+
+	/** @brief Uniformly sampled sphere surface. Normal vectors change smoothly, so clusters are divided depending on NT.
+	*/
+	inline void sphere(point_cloud<float>& cloud, const size_t number_of_points, const uint64_t seed)
+	{
+		std::mt19937_64 random(seed);
+		std::uniform_real_distribution<float> height(-1, 1);
+		std::uniform_real_distribution<float> angle(0, 6.2831853f);
+		const float radius = extent / 2;
+
+		memory_placement::reserve(cloud.points, number_of_points);
+
+		for (size_t i = 0; i < number_of_points; ++i)
+		{
+			const float nz = height(random);
+			const float phi = angle(random);
+			const float r = std::sqrt(1 - nz * nz);
+			const float nx = r * std::cos(phi), ny = r * std::sin(phi);
+
+			add_point(cloud, nx * radius, ny * radius, nz * radius, nx, ny, nz, random);
+		}
+	}
+
+	/** @brief Terrain-like height field scanned with Gaussian noise on position and normal vectors and 1 % of outliers.
+	*/
+	inline void noisy_scan(point_cloud<float>& cloud, const size_t number_of_points, const uint64_t seed)
+	{
+		std::mt19937_64 random(seed);
+		std::uniform_real_distribution<float> coordinate(0, extent);
+		std::uniform_real_distribution<float> unit(0, 1);
+		std::normal_distribution<float> noise(0, 0.05f);
+
+		memory_placement::reserve(cloud.points, number_of_points);
+
+		for (size_t i = 0; i < number_of_points; ++i)
+		{
+			const float x = coordinate(random);
+			const float y = coordinate(random);
+			const float frequency = 0.1f, amplitude = 5;
+
+			float z = amplitude * std::sin(frequency * x) * std::cos(frequency * y) + noise(random);
+
+			if (unit(random) < 0.01f) // outlier
+				z += coordinate(random) / 4;
+
+			// normal vector of height field z = f(x, y) is (-df/dx, -df/dy, 1)
+			float nx = -amplitude * frequency * std::cos(frequency * x) * std::cos(frequency * y) + noise(random);
+			float ny = amplitude * frequency * std::sin(frequency * x) * std::sin(frequency * y) + noise(random);
+			float nz = 1;
+			const float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+
+			nx /= length;
+			ny /= length;
+			nz /= length;
+
+			add_point(cloud, x, y, z, nx, ny, nz, random);
+		}
+	}
+
+	/** @brief Flat square with heavy-tailed density: points are grouped around random centres whose spread follows Pareto distribution,
+	 *	so there are few very dense spots and large sparse areas (as in scans with varying distance to scanner).
+	*/
+	inline void heavy_tailed(point_cloud<float>& cloud, const size_t number_of_points, const uint64_t seed)
+	{
+		std::mt19937_64 random(seed);
+		std::uniform_real_distribution<float> coordinate(0, extent);
+		std::uniform_real_distribution<float> unit(0, 1);
+		std::normal_distribution<float> offset(0, 1);
+
+		const size_t number_of_centres = 64;
+		float centres[number_of_centres][3];
+
+		for (size_t i = 0; i < number_of_centres; ++i)
+		{
+			centres[i][0] = coordinate(random);
+			centres[i][1] = coordinate(random);
+			centres[i][2] = 0.01f / std::pow(1 - unit(random) * 0.999f, 1 / 1.2f); // Pareto distributed spread (shape 1.2)
+		}
+
+		memory_placement::reserve(cloud.points, number_of_points);
+
+		for (size_t i = 0; i < number_of_points; ++i)
+		{
+			const float* centre = centres[random() % number_of_centres];
+			const float x = std::fmin(extent, std::fmax(0.0f, centre[0] + offset(random) * centre[2]));
+			const float y = std::fmin(extent, std::fmax(0.0f, centre[1] + offset(random) * centre[2]));
+
+			add_point(cloud, x, y, 0, 0, 0, 1, random);
+		}
+	}
+
+	/** @brief Generates cloud by name of generator ("plane", "sphere", "noisy_scan" or "heavy_tailed").
+	*/
+	inline void generate(const std::string& generator, point_cloud<float>& cloud, const size_t number_of_points, const uint64_t seed)
+	{
+		if (generator == "plane")
+			plane(cloud, number_of_points, seed);
+		else if (generator == "sphere")
+			sphere(cloud, number_of_points, seed);
+		else if (generator == "noisy_scan")
+			noisy_scan(cloud, number_of_points, seed);
+		else if (generator == "heavy_tailed")
+			heavy_tailed(cloud, number_of_points, seed);
+		else
+			throw std::invalid_argument("Unknown generator " + generator);
+
+		memory_placement::distribute(cloud.points);
+	}
+}
+#endif // SYNTHETIC_CLOUD_HPP
@@ -0,0 +1,499 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <utility>
+#include "optimizer.hpp"
+#include "batch_search.hpp"
+#include "claim_index.hpp"
+#include "cloud_cache.hpp"
+#include "implicit_kd_tree.hpp"
+#include "las_reader.hpp"
+#include "leaf_kernel.hpp"
+#include "ply_reader.hpp"
+#include "synthetic_cloud.hpp"
+
+using namespace std;
+using namespace nanoflann;
+
+/** @brief Unit tests run by ctest: round trips of readers, exporter and cache, equivalence of search indices with nanoflann,
+ *	equivalence of batched searches with searches of every query alone and equivalence of seed adjacency graph with radius search.
+ *	Files are written to working directory. Exit code is number of failed checks.
+*/
+
+size_t failed_checks = 0;
+
+void check(const bool condition, const string& description)
+{
+	if (!condition)
+	{
+		failed_checks++;
+		cerr << "FAILED: " << description << endl;
+	}
+}
+
+typedef vector<pair<point_index, float>> search_result;
+
+/** @brief Sorts search results by distance and index, so results of searches which order ties differently can be compared.
+*/
+search_result sorted(search_result results)
+{
+	sort(results.begin(), results.end(), [](const pair<point_index, float>& a, const pair<point_index, float>& b)
+	{
+		return a.second < b.second || (a.second == b.second && a.first < b.first);
+	});
+
+	return results;
+}
+
+/** @brief Exports every point of given cloud as its own cluster (centroid is point itself).
+*/
+void export_all_points(const point_cloud<float>& source, const string& file_name)
+{
+	reset_optimizer();
+	cloud = source;
+
+	for (size_t i = 0; i < cloud.points.size(); ++i)
+		new_clusters.push_back(cluster(1, static_cast<point_index>(i)));
+
+	export_point_cloud(file_name);
+	reset_optimizer();
+}
+
+/** @brief Compares clouds point by point. Coordinates and normal vectors are compared with relative tolerance
+ *	(.ply export writes 7 significant digits), colors must be equal.
+*/
+void check_same_points(const point_cloud<float>& expected, const point_cloud<float>& actual, const float tolerance, const string& description)
+{
+	check(expected.points.size() == actual.points.size(), description + ": number of points");
+
+	if (expected.points.size() != actual.points.size())
+		return;
+
+	size_t different_points = 0;
+
+	for (size_t i = 0; i < expected.points.size(); ++i)
+	{
+		for (int j = 0; j < 9; ++j)
+		{
+			const float a = expected.points[i].data[j], b = actual.points[i].data[j];
+			const float allowed = j >= 3 && j < 6 ? 0 : tolerance * max(1.0f, fabs(a));
+
+			if (fabs(a - b) > allowed)
+			{
+				different_points++;
+				break;
+			}
+		}
+	}
+
+	check(different_points == 0, description + ": " + to_string(different_points) + " points differ");
+}
+
+void test_ply_round_trip()
+{
+	point_cloud<float> source;
+	synthetic_cloud::noisy_scan(source, 20000, 1);
+
+	export_all_points(source, "test_round_trip_1.ply");
+
+	point_cloud<float> first;
+	ply_reader().read("test_round_trip_1.ply", first);
+	check_same_points(source, first, 1e-6f, "PLY round trip");
+
+	export_all_points(first, "test_round_trip_2.ply");
+
+	point_cloud<float> second;
+	ply_reader().read("test_round_trip_2.ply", second);
+	check_same_points(first, second, 1e-6f, "PLY to PLY round trip");
+
+	remove("test_round_trip_1.ply");
+	remove("test_round_trip_2.ply");
+}
+
+/** @brief Writes uncompressed LAS 1.2 file with point data record format 2 (coordinates and 16-bit colors).
+ *	Coordinates are stored with scale 0.001 and offset 1000 on every axis; first point is minimum of bounding box.
+*/
+void write_las(const string& file_name, const vector<int32_t>& coordinates, const vector<uint16_t>& colors)
+{
+	const size_t header_size = 227, record_length = 26, n = colors.size() / 3;
+	vector<unsigned char> data(header_size + n * record_length);
+
+	auto put = [&data](const size_t position, const void* value, const size_t size) { memcpy(data.data() + position, value, size); };
+	const uint16_t header_size_value = header_size, record_length_value = record_length;
+	const uint32_t offset_to_points = header_size, number_of_points = static_cast<uint32_t>(n);
+	const double scale = 0.001, offset = 1000;
+
+	put(0, "LASF", 4);
+	data[24] = 1;
+	data[25] = 2;
+	put(94, &header_size_value, 2);
+	put(96, &offset_to_points, 4);
+	data[104] = 2;
+	put(105, &record_length_value, 2);
+	put(107, &number_of_points, 4);
+
+	for (int d = 0; d < 3; ++d)
+	{
+		const double min = offset + coordinates[d] * scale, max = offset + *max_element(coordinates.begin(), coordinates.end()) * scale;
+		put(131 + 8 * d, &scale, 8);
+		put(155 + 8 * d, &offset, 8);
+		put(179 + 16 * d, &max, 8);
+		put(187 + 16 * d, &min, 8);
+	}
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		put(header_size + i * record_length, &coordinates[3 * i], 12);
+		put(header_size + i * record_length + 20, &colors[3 * i], 6);
+	}
+
+	ofstream(file_name, ios::binary).write(reinterpret_cast<const char*>(data.data()), static_cast<streamsize>(data.size()));
+}
+
+/** @brief 16-bit LAS colors are read as integers 0 - 255, so export writes valid uchar colors and cache keeps same colors as direct read.
+*/
+void test_las_round_trip()
+{
+	const size_t n = 5000;
+	mt19937_64 random(5);
+	vector<int32_t> coordinates(3 * n);
+	vector<uint16_t> colors(3 * n);
+
+	for (size_t i = 0; i < 3 * n; ++i)
+	{
+		coordinates[i] = i < 3 ? 0 : static_cast<int32_t>(random() % 100000);
+		colors[i] = i < 3 ? 65535 : static_cast<uint16_t>(random());
+	}
+
+	write_las("test_round_trip.las", coordinates, colors);
+
+	point_cloud<float> source;
+	las_reader().read("test_round_trip.las", source);
+
+	size_t wrong_colors = 0;
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			wrong_colors += source.points[i].data[3 + j] != min(255.0, round(colors[3 * i + j] / 257.0));
+	}
+
+	check(source.has_colors && wrong_colors == 0, "16-bit LAS colors: " + to_string(wrong_colors) + " colors are not scaled to integers 0 - 255");
+
+	export_all_points(source, "test_round_trip_las_1.ply");
+
+	point_cloud<float> first;
+	ply_reader().read("test_round_trip_las_1.ply", first);
+	check_same_points(source, first, 1e-6f, "LAS to PLY round trip");
+
+	export_all_points(first, "test_round_trip_las_2.ply");
+
+	point_cloud<float> second;
+	ply_reader().read("test_round_trip_las_2.ply", second);
+	check_same_points(first, second, 1e-6f, "LAS to PLY to PLY round trip");
+
+	cloud_cache::write("test_round_trip.las.pcc", "test_round_trip.las", source, false);
+
+	point_cloud<float> cached;
+	cloud_cache::reader().read("test_round_trip.las.pcc", cached);
+	check_same_points(source, cached, 0, "LAS cache round trip");
+
+	remove("test_round_trip.las");
+	remove("test_round_trip.las.pcc");
+	remove("test_round_trip_las_1.ply");
+	remove("test_round_trip_las_2.ply");
+}
+
+void test_cache_round_trip()
+{
+	point_cloud<float> source;
+	synthetic_cloud::sphere(source, 20000, 2);
+
+	export_all_points(source, "test_cache_source.ply");
+
+	point_cloud<float> parsed;
+	ply_reader().read("test_cache_source.ply", parsed);
+
+	for (const bool morton_ordered : { false, true })
+	{
+		point_cloud<float> expected = parsed;
+
+		if (morton_ordered)
+			cloud_cache::sort_by_morton_code(expected);
+
+		cloud_cache::write("test_cache_source.ply.pcc", "test_cache_source.ply", expected, morton_ordered);
+		check(cloud_cache::is_valid("test_cache_source.ply.pcc", "test_cache_source.ply", morton_ordered), "cache is valid after it was written");
+
+		point_cloud<float> cached;
+		cloud_cache::reader().read("test_cache_source.ply.pcc", cached);
+		check_same_points(expected, cached, 0, morton_ordered ? "cache round trip (Morton order)" : "cache round trip");
+	}
+
+	remove("test_cache_source.ply");
+	remove("test_cache_source.ply.pcc");
+}
+
+/** @brief Compares radius and k nearest neighbour searches of implicit K-D tree and radius search of claim index with nanoflann,
+ *	using currently active leaf kernel. Every 7th point is claimed halfway, so claim index has to skip claimed points.
+*/
+void test_search_equivalence(const point_cloud<float>& points, const string& kernel_name)
+{
+	tree reference(point::dimension, points, KDTreeSingleIndexAdaptorParams(50));
+	reference.buildIndex();
+
+	implicit_kd_tree compact_tree(points, 50);
+	compact_tree.build();
+
+	claim_index unclaimed_points(points);
+	unclaimed_points.build(reference);
+
+	const size_t k = 12;
+	const float squared_radius = 1.5f * 1.5f;
+	size_t radius_mismatches = 0, knn_mismatches = 0, claim_mismatches = 0;
+
+	search_result expected, actual;
+	vector<point_index> expected_indices(k), actual_indices(k);
+	vector<float> expected_distances(k), actual_distances(k);
+	bool has_claims = false;
+
+	for (size_t i = 0; i < points.points.size(); i += 13)
+	{
+		const float* query = points.points[i].data;
+
+		reference.radiusSearch(query, squared_radius, expected, SearchParams());
+		expected = sorted(expected);
+
+		compact_tree.radiusSearch(query, squared_radius, actual, SearchParams());
+		radius_mismatches += sorted(actual) != expected;
+
+		if (!has_claims && i >= points.points.size() / 2)
+		{
+			for (size_t j = 0; j < points.points.size(); j += 7)
+				unclaimed_points.claim(static_cast<point_index>(j));
+
+			has_claims = true;
+		}
+
+		if (has_claims)
+			expected.erase(remove_if(expected.begin(), expected.end(), [](const pair<point_index, float>& match) { return match.first % 7 == 0; }), expected.end());
+
+		unclaimed_points.radiusSearch(query, squared_radius, actual, SearchParams());
+		claim_mismatches += sorted(actual) != expected;
+
+		const size_t expected_count = reference.knnSearch(query, k, expected_indices.data(), expected_distances.data());
+		const size_t actual_count = compact_tree.knnSearch(query, k, actual_indices.data(), actual_distances.data());
+		knn_mismatches += expected_count != actual_count || expected_distances != actual_distances || expected_indices != actual_indices;
+	}
+
+	check(radius_mismatches == 0, "implicit_kd_tree radius search (" + kernel_name + " kernel): " + to_string(radius_mismatches) + " queries differ from nanoflann");
+	check(knn_mismatches == 0, "implicit_kd_tree knn search (" + kernel_name + " kernel): " + to_string(knn_mismatches) + " queries differ from nanoflann");
+	check(claim_mismatches == 0, "claim_index radius search (" + kernel_name + " kernel): " + to_string(claim_mismatches) + " queries differ from nanoflann");
+}
+
+/** @brief Compares batched knn and radius searches of nanoflann K-D tree with knnSearch and radiusSearch of every query alone.
+ *	Queries are batched in order of leaves of tree as normal estimation does, results are compared sorted (order of ties may differ).
+*/
+void test_batch_search(const point_cloud<float>& points, const string& generator)
+{
+	tree reference(point::dimension, points, KDTreeSingleIndexAdaptorParams(50));
+	reference.buildIndex();
+
+	batch_search::searcher<tree> searcher(reference);
+
+	const size_t k = 12;
+	const size_t batch_size = batch_search::default_batch_size;
+	const float squared_radius = 1.5f * 1.5f;
+	size_t radius_mismatches = 0, knn_mismatches = 0;
+
+	vector<point_index> indices(batch_size * k), expected_indices(k);
+	vector<float> distances(batch_size * k), expected_distances(k);
+	vector<search_result> radius_results(batch_size);
+	search_result expected, actual;
+
+	vector<const float*> queries;
+	vector<KNNResultSet<float, point_index>> knn_sets;
+	vector<RadiusResultSet<float, point_index>> radius_sets;
+
+	for (size_t batch_begin = 0; batch_begin < points.points.size(); batch_begin += batch_size)
+	{
+		const size_t batch_end = min(points.points.size(), batch_begin + batch_size);
+
+		queries.clear();
+		knn_sets.clear();
+		radius_sets.clear();
+
+		for (size_t position = batch_begin; position < batch_end; ++position)
+		{
+			const size_t b = position - batch_begin;
+
+			queries.push_back(points.points[reference.vind[position]].data);
+			knn_sets.emplace_back(k);
+			knn_sets.back().init(indices.data() + b * k, distances.data() + b * k);
+			radius_sets.emplace_back(squared_radius, radius_results[b]);
+		}
+
+		searcher.find_neighbours(queries.data(), queries.size(), knn_sets.data());
+		searcher.find_neighbours(queries.data(), queries.size(), radius_sets.data());
+
+		for (size_t b = 0; b < queries.size(); ++b)
+		{
+			reference.radiusSearch(queries[b], squared_radius, expected, SearchParams());
+			radius_mismatches += sorted(radius_results[b]) != sorted(expected);
+
+			const size_t expected_count = reference.knnSearch(queries[b], k, expected_indices.data(), expected_distances.data());
+			expected.clear();
+			actual.clear();
+
+			for (size_t j = 0; j < expected_count; ++j)
+				expected.emplace_back(expected_indices[j], expected_distances[j]);
+
+			for (size_t j = 0; j < knn_sets[b].size(); ++j)
+				actual.emplace_back(indices[b * k + j], distances[b * k + j]);
+
+			knn_mismatches += sorted(actual) != sorted(expected);
+		}
+	}
+
+	check(radius_mismatches == 0, "batch_search radius search (" + generator + " cloud): " + to_string(radius_mismatches) + " queries differ from nanoflann");
+	check(knn_mismatches == 0, "batch_search knn search (" + generator + " cloud): " + to_string(knn_mismatches) + " queries differ from nanoflann");
+}
+
+/** @brief Compares every leaf kernel supported by processor with scalar kernel on leaves of all sizes up to 100 points
+ *	and runs search equivalence tests with it.
+*/
+void test_leaf_kernels()
+{
+	point_cloud<float> points;
+	synthetic_cloud::noisy_scan(points, 30000, 3);
+
+	const leaf_kernel::selection original = leaf_kernel::active();
+
+	for (const string name : { "scalar", "avx2", "avx512" })
+	{
+		const leaf_kernel::selection kernel = leaf_kernel::select(name);
+
+		if (kernel.name != name)
+		{
+			cout << "Leaf kernel " << name << " is not supported by processor; its tests are skipped." << endl;
+			continue;
+		}
+
+		size_t mismatches = 0;
+
+		for (size_t count = 1; count <= 100; ++count)
+		{
+			vector<float> x(count), y(count), z(count);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				x[i] = points.points[i].data[0];
+				y[i] = points.points[i].data[1];
+				z[i] = points.points[i].data[2];
+			}
+
+			const float* query = points.points[count / 2].data;
+			vector<uint32_t> expected_hits(count), actual_hits(count);
+			vector<float> expected_distances(count), actual_distances(count);
+
+			for (const float squared_radius : { 0.0f, 4.0f, 100.0f, 1e6f })
+			{
+				const size_t expected_count = leaf_kernel::scan_scalar(x.data(), y.data(), z.data(), count, query, squared_radius, expected_hits.data(), expected_distances.data());
+				const size_t actual_count = kernel.scan(x.data(), y.data(), z.data(), count, query, squared_radius, actual_hits.data(), actual_distances.data());
+
+				mismatches += expected_count != actual_count
+					|| !equal(expected_hits.begin(), expected_hits.begin() + expected_count, actual_hits.begin())
+					|| !equal(expected_distances.begin(), expected_distances.begin() + expected_count, actual_distances.begin());
+			}
+		}
+
+		check(mismatches == 0, "leaf kernel " + name + ": " + to_string(mismatches) + " scans differ from scalar kernel");
+
+		leaf_kernel::active() = kernel;
+		test_search_equivalence(points, name);
+	}
+
+	leaf_kernel::active() = original;
+}
+
+/** @brief Compares seed adjacency graph recorded by cluster initialization with radius search of K-D tree over centroids of initial clusters.
+*/
+void test_seed_graph()
+{
+	reset_optimizer();
+	synthetic_cloud::noisy_scan(cloud, 50000, 4);
+
+	tree my_tree(point::dimension, cloud, KDTreeSingleIndexAdaptorParams(50));
+	my_tree.buildIndex();
+
+	space_interval_dt = 0.7f;
+	record_seed_graph = true;
+	cluster_initialization(my_tree);
+	record_seed_graph = false;
+
+	check(seed_adjacency.size() == initial_clusters.size(), "seed graph has vertex for every initial cluster");
+
+	if (seed_adjacency.size() != initial_clusters.size())
+		return;
+
+	point_subset<float> centroids(cloud);
+
+	for (const cluster& init_cluster : initial_clusters)
+		centroids.indices.push_back(init_cluster[0]);
+
+	subset_tree centroid_tree(point::dimension, centroids, KDTreeSingleIndexAdaptorParams(10));
+	centroid_tree.buildIndex();
+
+	const float radius = 3 * space_interval_dt * space_interval_dt;
+	size_t mismatches = 0;
+	search_result matches;
+
+	for (size_t i = 0; i < initial_clusters.size(); ++i)
+	{
+		centroid_tree.radiusSearch(cloud.points[initial_clusters[i][0]].data, radius, matches, SearchParams());
+
+		vector<point_index> expected;
+
+		for (const auto& match : matches)
+		{
+			if (match.first != i) // centroid itself is not its own neighbour in graph
+				expected.push_back(match.first);
+		}
+
+		sort(expected.begin(), expected.end());
+		mismatches += expected.size() != seed_adjacency.degree(i) || !equal(expected.begin(), expected.end(), seed_adjacency.neighbours_of(i));
+	}
+
+	check(mismatches == 0, "seed graph: " + to_string(mismatches) + " seeds have other neighbours than radius search finds");
+
+	reset_optimizer();
+}
+
+int main()
+{
+	test_ply_round_trip();
+	test_las_round_trip();
+	test_cache_round_trip();
+	test_leaf_kernels();
+
+	for (const string generator : { "plane", "sphere", "noisy_scan", "heavy_tailed" })
+	{
+		point_cloud<float> points;
+		synthetic_cloud::generate(generator, points, 20000, 5);
+		test_batch_search(points, generator);
+	}
+
+	test_seed_graph();
+
+	if (failed_checks > 0)
+		cerr << failed_checks << " checks failed." << endl;
+	else
+		cout << endl << "All checks passed." << endl;
+
+	return static_cast<int>(min<size_t>(failed_checks, 255));
+}